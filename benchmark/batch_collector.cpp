@@ -0,0 +1,155 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread/thread.hpp>
+#include <rethread_ext/batch_collector.hpp>
+#include <rethread_ext/timed_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+	/// @brief The usual collector: a vector under a mutex, the consumer re-registers with the token on every wake up
+	class mutex_collector
+	{
+		std::mutex              _mutex;
+		std::condition_variable _cv;
+		std::vector<int>        _items;
+		std::vector<int>        _batch;
+		size_t                  _capacity;
+		size_t                  _threshold{0};
+
+	public:
+		explicit mutex_collector(size_t capacity) :
+			_capacity(capacity)
+		{
+			_items.reserve(capacity);
+			_batch.reserve(capacity);
+		}
+
+		bool append(int item, const rethread::cancellation_token& token)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			while (_items.size() >= _capacity)
+				if (rethread::wait_for(_cv, l, std::chrono::milliseconds(1), token) == rethread::wait_result::cancelled)
+					return false;
+			_items.push_back(item);
+			if (_items.size() == _threshold)
+				_cv.notify_all();
+			return true;
+		}
+
+		template <typename Rep_, typename Period_>
+		const std::vector<int>& collect(size_t max_items, const std::chrono::duration<Rep_, Period_>& max_delay, const rethread::cancellation_token& token)
+		{
+			auto deadline = std::chrono::steady_clock::now() + max_delay;
+			std::unique_lock<std::mutex> l(_mutex);
+			_threshold = max_items;
+			while (_items.size() < max_items && rethread::wait_until(_cv, l, deadline, token) == rethread::wait_result::ready)
+				;
+			_threshold = 0;
+			_batch.clear();
+			_batch.swap(_items);
+			_cv.notify_all();
+			return _batch;
+		}
+	};
+
+
+	static const int ItemsPerIteration = 1 << 16;
+
+
+	/// @brief Producers share ItemsPerIteration items, the benchmark thread collects them in batches of state.range_x()
+	template <typename Collector_, int ProducersCount_>
+	void run_throughput(benchmark::State& state)
+	{
+		size_t batch_size = static_cast<size_t>(state.range_x());
+		Collector_ collector(batch_size);
+		rethread::standalone_cancellation_token token;
+		while (state.KeepRunning())
+		{
+			std::vector<std::thread> producers;
+			for (int p = 0; p < ProducersCount_; ++p)
+				producers.emplace_back([&collector, &token, p]
+				{
+					for (int i = p; i < ItemsPerIteration; i += ProducersCount_)
+						collector.append(i, token);
+				});
+
+			int received = 0;
+			while (received < ItemsPerIteration)
+				received += static_cast<int>(collector.collect(batch_size, std::chrono::milliseconds(1), token).size());
+
+			for (size_t i = 0; i < producers.size(); ++i)
+				producers[i].join();
+		}
+		state.SetItemsProcessed(state.iterations() * ItemsPerIteration);
+	}
+
+
+	/// @brief The benchmark thread appends a whole batch and waits until the consumer thread has taken it
+	template <typename Collector_>
+	void run_flush_latency(benchmark::State& state)
+	{
+		size_t batch_size = static_cast<size_t>(state.range_x());
+		Collector_ collector(batch_size);
+		std::atomic<size_t> received{0};
+		rethread::thread consumer([&] (const rethread::cancellation_token& token)
+		{
+			while (token)
+				received.fetch_add(collector.collect(batch_size, std::chrono::seconds(1), token).size(), std::memory_order_release);
+		});
+
+		rethread::standalone_cancellation_token token;
+		size_t expected = 0;
+		while (state.KeepRunning())
+		{
+			for (size_t i = 0; i < batch_size; ++i)
+				collector.append(static_cast<int>(i), token);
+			expected += batch_size;
+			while (received.load(std::memory_order_acquire) != expected)
+				std::this_thread::yield();
+		}
+		state.SetItemsProcessed(state.iterations() * batch_size);
+	}
+}
+
+
+template <int ProducersCount_>
+static void batch_collector_throughput(benchmark::State& state)
+{ run_throughput<rethread::batch_collector<int>, ProducersCount_>(state); }
+BENCHMARK_TEMPLATE(batch_collector_throughput, 1)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(batch_collector_throughput, 4)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(batch_collector_throughput, 16)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+
+
+template <int ProducersCount_>
+static void mutex_collector_throughput(benchmark::State& state)
+{ run_throughput<mutex_collector, ProducersCount_>(state); }
+BENCHMARK_TEMPLATE(mutex_collector_throughput, 1)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(mutex_collector_throughput, 4)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(mutex_collector_throughput, 16)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+
+
+static void batch_collector_flush_latency(benchmark::State& state)
+{ run_flush_latency<rethread::batch_collector<int>>(state); }
+BENCHMARK(batch_collector_flush_latency)->Arg(1)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+
+
+static void mutex_collector_flush_latency(benchmark::State& state)
+{ run_flush_latency<mutex_collector>(state); }
+BENCHMARK(mutex_collector_flush_latency)->Arg(1)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
@@ -9,6 +9,12 @@
 
 #include <benchmark/benchmark.h>
 
+#include <rethread_ext/compact_cancellation_token.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
 static void old_concurrent_queue(benchmark::State& state)
 {
 	std::mutex m;
@@ -207,14 +213,20 @@ class testing_storage
 {
 	using storage_type = typename std::aligned_storage<sizeof(T), RETHREAD_ALIGNOF(T)>::type;
 
-	storage_type* _storage{nullptr};
-	size_t        _storageSize{0};
-	size_t        _size{0};
+	std::unique_ptr<char[]> _buffer;
+	storage_type*           _storage{nullptr};
+	size_t                  _storageSize{0};
+	size_t                  _size{0};
 
 public:
+	// Aligned by hand, because new of an over-aligned type is not guaranteed to respect the alignment before C++17
 	testing_storage(size_t storageSize) :
-		_storage(new storage_type[storageSize]), _storageSize(storageSize)
-	{ }
+		_buffer(new char[(storageSize + 1) * sizeof(storage_type)]), _storageSize(storageSize)
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(_buffer.get());
+		address = (address + RETHREAD_ALIGNOF(storage_type) - 1) / RETHREAD_ALIGNOF(storage_type) * RETHREAD_ALIGNOF(storage_type);
+		_storage = reinterpret_cast<storage_type*>(address);
+	}
 
 	testing_storage(const testing_storage&) = delete;
 	testing_storage& operator =(const testing_storage&) = delete;
@@ -222,7 +234,6 @@ public:
 	~testing_storage()
 	{
 		clear();
-		delete[] _storage;
 	}
 
 	void clear()
@@ -328,4 +339,33 @@ static void create_sourced_cancellation_token(benchmark::State& state)
 BENCHMARK(create_sourced_cancellation_token)->Arg(CreationBatchSize);
 
 
+template <typename Token_>
+static void create_token(benchmark::State& state)
+{
+	try
+	{
+		size_t BatchSize = state.range_x();
+		using storage_type = testing_storage<Token_>;
+		storage_type storage(BatchSize);
+		while (state.KeepRunning())
+		{
+			if (RETHREAD_UNLIKELY(storage.size() == BatchSize))
+			{
+				state.PauseTiming();
+				storage.clear();
+				state.ResumeTiming();
+			}
+
+			benchmark::DoNotOptimize(&storage.emplace_back());
+		}
+		state.SetLabel(std::to_string(sizeof(Token_)) + " bytes per token");
+	}
+	catch (const std::exception& ex)
+	{ state.SkipWithError(ex.what()); }
+}
+BENCHMARK_TEMPLATE(create_token, rethread::compact_cancellation_token)->Arg(CreationBatchSize);
+BENCHMARK_TEMPLATE(create_token, rethread::padded_standalone_cancellation_token)->Arg(CreationBatchSize);
+BENCHMARK_TEMPLATE(create_token, rethread::padded_compact_cancellation_token)->Arg(CreationBatchSize);
+
+
 BENCHMARK_MAIN()
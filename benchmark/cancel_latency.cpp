@@ -0,0 +1,142 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/cancellation_dispatcher.hpp>
+
+#include <memory>
+#include <vector>
+
+
+// Does the same work as the handler of rethread::wait
+struct notifying_handler : public rethread::cancellation_handler
+{
+	std::mutex              _mutex;
+	std::condition_variable _cv;
+
+	void cancel() override
+	{
+		std::unique_lock<std::mutex> l(_mutex);
+		_cv.notify_all();
+	}
+};
+
+
+class registered_handlers
+{
+	using guard_ptr = std::unique_ptr<rethread::cancellation_guard>;
+
+	std::vector<notifying_handler>                    _handlers;
+	std::vector<rethread::sourced_cancellation_token> _tokens;
+	std::vector<guard_ptr>                            _guards; // destroyed first
+
+public:
+	registered_handlers(rethread::cancellation_token_source& source, size_t count) :
+		_handlers(count)
+	{
+		_tokens.reserve(count);
+		_guards.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			_tokens.push_back(source.create_token());
+			_guards.emplace_back(new rethread::cancellation_guard(_tokens.back(), _handlers[i]));
+		}
+	}
+};
+
+
+static void cancel_latency_sync(benchmark::State& state)
+{
+	size_t HandlersCount = state.range_x();
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		{
+			rethread::cancellation_token_source source;
+			registered_handlers handlers(source, HandlersCount);
+			state.ResumeTiming();
+
+			source.cancel();
+
+			state.PauseTiming();
+		}
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(cancel_latency_sync)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+
+
+static void cancel_latency_async(benchmark::State& state)
+{
+	size_t HandlersCount = state.range_x();
+	rethread::cancellation_dispatcher dispatcher;
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		{
+			rethread::cancellation_token_source source;
+			registered_handlers handlers(source, HandlersCount);
+			rethread::async_canceller<rethread::cancellation_token_source> canceller(source, dispatcher);
+			state.ResumeTiming();
+
+			canceller.cancel();
+
+			state.PauseTiming();
+			canceller.wait();
+		}
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(cancel_latency_async)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+
+
+static void cancel_latency_standalone_sync(benchmark::State& state)
+{
+	notifying_handler handler;
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		{
+			rethread::standalone_cancellation_token token;
+			rethread::cancellation_guard guard(token, handler);
+			state.ResumeTiming();
+
+			token.cancel();
+
+			state.PauseTiming();
+		}
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(cancel_latency_standalone_sync);
+
+
+static void cancel_latency_standalone_async(benchmark::State& state)
+{
+	notifying_handler handler;
+	rethread::cancellation_dispatcher dispatcher;
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		{
+			rethread::standalone_cancellation_token token;
+			rethread::cancellation_guard guard(token, handler);
+			rethread::async_canceller<rethread::standalone_cancellation_token> canceller(token, dispatcher);
+			state.ResumeTiming();
+
+			canceller.cancel();
+
+			state.PauseTiming();
+			canceller.wait();
+		}
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(cancel_latency_standalone_async);
@@ -0,0 +1,174 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#if defined(RETHREAD_HAS_POLL) && defined(RETHREAD_HAS_COROUTINES)
+
+#include <rethread_ext/coroutine.hpp>
+
+#include <pthread.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+static std::atomic<size_t> coroutine_frame_bytes{0};
+
+
+// Same as rethread::detached_task, but counts the memory of coroutine frames
+class counted_task
+{
+public:
+	struct promise_type
+	{
+		static void* operator new(size_t size)
+		{
+			coroutine_frame_bytes += size;
+			return ::operator new(size);
+		}
+
+		static void operator delete(void* ptr)
+		{ ::operator delete(ptr); }
+
+		counted_task get_return_object() { return counted_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	std::coroutine_handle<> _handle;
+
+private:
+	explicit counted_task(std::coroutine_handle<promise_type> handle) : _handle(handle) { }
+};
+
+
+static counted_task wait_for_cancel(rethread::sourced_cancellation_token token)
+{ co_await rethread::cancelled(token); }
+
+
+static counted_task wait_for_cancel_ref(const rethread::cancellation_token& token, std::atomic<bool>* woke)
+{
+	co_await rethread::cancelled(token);
+	*woke = true;
+}
+
+
+// Spawns, suspends and cancels a batch of pending operations
+static void coroutine_pending_operations(benchmark::State& state)
+{
+	size_t Count = state.range_x();
+	rethread::coroutine_scheduler scheduler;
+	while (state.KeepRunning())
+	{
+		coroutine_frame_bytes = 0;
+		rethread::cancellation_token_source source;
+		for (size_t i = 0; i < Count; ++i)
+			scheduler.post(wait_for_cancel(source.create_token())._handle);
+		scheduler.run_ready();
+
+		source.cancel();
+		scheduler.run_ready();
+	}
+	state.SetItemsProcessed(state.iterations() * Count);
+	state.SetLabel(std::to_string(coroutine_frame_bytes / Count) + " bytes of frame per pending operation");
+}
+BENCHMARK(coroutine_pending_operations)->Arg(1000)->Arg(10000);
+
+
+// Same with a thread blocked in rethread::wait per operation
+static void thread_pending_operations(benchmark::State& state)
+{
+	size_t Count = state.range_x();
+	while (state.KeepRunning())
+	{
+		std::mutex m;
+		std::condition_variable cv;
+		std::vector<std::unique_ptr<rethread::thread>> waiters;
+		for (size_t i = 0; i < Count; ++i)
+			waiters.emplace_back(new rethread::thread([&] (const rethread::cancellation_token& t)
+			{
+				std::unique_lock<std::mutex> l(m);
+				while (t)
+					rethread::wait(cv, l, t);
+			}));
+		waiters.clear();
+	}
+	state.SetItemsProcessed(state.iterations() * Count);
+
+	pthread_attr_t attr;
+	size_t stack_size = 0;
+	if (::pthread_attr_init(&attr) == 0)
+	{
+		::pthread_attr_getstacksize(&attr, &stack_size);
+		::pthread_attr_destroy(&attr);
+	}
+	state.SetLabel(std::to_string(stack_size) + " bytes of stack reserved per pending operation");
+}
+BENCHMARK(thread_pending_operations)->Arg(16)->Arg(256);
+
+
+// Cancellation posts the coroutine to the scheduler of this thread, nobody is woken up
+static void coroutine_resume_latency(benchmark::State& state)
+{
+	rethread::coroutine_scheduler scheduler;
+	rethread::standalone_cancellation_token token;
+	std::atomic<bool> woke{false};
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		token.reset();
+		woke = false;
+		scheduler.post(wait_for_cancel_ref(token, &woke)._handle);
+		scheduler.run_ready();
+		state.ResumeTiming();
+
+		token.cancel();
+		scheduler.run_ready();
+		RETHREAD_ASSERT(woke, "Coroutine wasn't resumed!");
+	}
+}
+BENCHMARK(coroutine_resume_latency);
+
+
+static void thread_resume_latency(benchmark::State& state)
+{
+	rethread::standalone_cancellation_token token;
+	std::atomic<bool> started{false}, woke{false};
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		token.reset();
+		started = false;
+		woke = false;
+		rethread::thread t([&] (const rethread::cancellation_token&)
+		{
+			started = true;
+			rethread::this_thread::sleep_for(std::chrono::minutes(1), token);
+			woke = true;
+		});
+		while (!started)
+			std::this_thread::yield();
+		state.ResumeTiming();
+
+		token.cancel();
+		while (!woke)
+			std::this_thread::yield();
+
+		state.PauseTiming();
+		t.reset();
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(thread_resume_latency);
+
+#endif
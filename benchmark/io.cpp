@@ -0,0 +1,115 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#if defined(RETHREAD_HAS_POLL)
+
+#include <rethread_ext/io.hpp>
+
+#include <fcntl.h>
+
+#include <system_error>
+#include <vector>
+
+
+class nonblocking_fd_pair
+{
+	int _fds[2];
+
+public:
+	explicit nonblocking_fd_pair(bool socket)
+	{
+		if (socket)
+			RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, _fds) == 0, std::system_error(errno, std::system_category()));
+		else
+			RETHREAD_CHECK(::pipe(_fds) == 0, std::system_error(errno, std::system_category()));
+
+		for (int fd : _fds)
+			::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+
+	nonblocking_fd_pair(const nonblocking_fd_pair&) = delete;
+	nonblocking_fd_pair& operator =(const nonblocking_fd_pair&) = delete;
+
+	~nonblocking_fd_pair()
+	{
+		::close(_fds[0]);
+		::close(_fds[1]);
+	}
+
+	int read_end() const  { return _fds[0]; }
+	int write_end() const { return _fds[1]; }
+};
+
+
+static ssize_t read_first(int fd, void* buf, size_t count, const rethread::cancellation_token& token)
+{ return rethread::read(fd, buf, count, token); }
+
+
+static ssize_t poll_then_read(int fd, void* buf, size_t count, const rethread::cancellation_token& token)
+{
+	if (rethread::poll(fd, POLLIN, token) != POLLIN)
+		return -1;
+	return ::read(fd, buf, count);
+}
+
+
+template <typename ReadFunc_>
+static void fd_read_throughput(benchmark::State& state, bool socket, const ReadFunc_& read_func)
+{
+	try
+	{
+		size_t ChunkSize = state.range_x();
+		nonblocking_fd_pair fds(socket);
+		std::vector<char> out(ChunkSize), in(ChunkSize);
+
+		rethread::thread writer([&] (const rethread::cancellation_token& t)
+		{
+			while (t)
+				rethread::write(fds.write_end(), out.data(), out.size(), t);
+		});
+
+		rethread::standalone_cancellation_token token;
+		size_t bytes = 0;
+		while (state.KeepRunning())
+		{
+			ssize_t result = read_func(fds.read_end(), in.data(), in.size(), token);
+			if (result > 0)
+				bytes += result;
+		}
+		writer.reset();
+
+		state.SetBytesProcessed(bytes);
+	}
+	catch (const std::exception& ex)
+	{ state.SkipWithError(ex.what()); }
+}
+
+
+static void pipe_read(benchmark::State& state)
+{ fd_read_throughput(state, false, &read_first); }
+BENCHMARK(pipe_read)->Arg(64)->Arg(4096)->Arg(65536);
+
+
+static void pipe_poll_then_read(benchmark::State& state)
+{ fd_read_throughput(state, false, &poll_then_read); }
+BENCHMARK(pipe_poll_then_read)->Arg(64)->Arg(4096)->Arg(65536);
+
+
+static void socketpair_read(benchmark::State& state)
+{ fd_read_throughput(state, true, &read_first); }
+BENCHMARK(socketpair_read)->Arg(64)->Arg(4096)->Arg(65536);
+
+
+static void socketpair_poll_then_read(benchmark::State& state)
+{ fd_read_throughput(state, true, &poll_then_read); }
+BENCHMARK(socketpair_poll_then_read)->Arg(64)->Arg(4096)->Arg(65536);
+
+#endif
@@ -0,0 +1,99 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/pipeline.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct timed_item
+{
+	std::chrono::steady_clock::time_point created;
+	long                                  value;
+};
+
+
+static RETHREAD_CONSTEXPR size_t ItemsPerIteration = 4096;
+
+
+// parse -> enrich -> write, one thread per stage.
+// Every iteration pushes ItemsPerIteration items and waits until the sink has consumed them, so the drain is timed as well
+template <typename Push_>
+static void run_pipeline(benchmark::State& state, const Push_& push_func)
+{
+	rethread::pipeline_options options;
+	options.batch_size = state.range_x();
+
+	std::chrono::steady_clock::duration latency{0};
+	std::atomic<size_t> received{0};
+	{
+		auto p = rethread::make_pipeline<timed_item>(options)
+			.template stage<timed_item>([] (timed_item&& item) { item.value += 1; return item; })
+			.template stage<timed_item>([] (timed_item&& item) { item.value *= 2; return item; })
+			.sink([&] (timed_item&& item)
+			{
+				benchmark::DoNotOptimize(item.value);
+				latency += std::chrono::steady_clock::now() - item.created;
+				received.fetch_add(1, std::memory_order_release);
+			});
+
+		rethread::standalone_cancellation_token token;
+		size_t pushed = 0;
+		while (state.KeepRunning())
+		{
+			push_func(p, token);
+			pushed += ItemsPerIteration;
+			while (received.load(std::memory_order_acquire) != pushed)
+				std::this_thread::yield();
+		}
+		p.close();
+		p.wait();
+	}
+
+	state.SetItemsProcessed(state.iterations() * ItemsPerIteration);
+	if (received != 0)
+		state.SetLabel("mean latency " + std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count() / received) + " ns");
+}
+
+
+static void pipeline_single_input(benchmark::State& state)
+{
+	run_pipeline(state, [] (rethread::pipeline<timed_item>& p, const rethread::cancellation_token& token)
+	{
+		for (size_t i = 0; i < ItemsPerIteration; ++i)
+			p.push(timed_item{std::chrono::steady_clock::now(), 0}, token);
+	});
+}
+BENCHMARK(pipeline_single_input)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+
+
+static void pipeline_batched_input(benchmark::State& state)
+{
+	size_t BatchSize = state.range_x();
+	std::vector<timed_item> batch;
+	batch.reserve(BatchSize);
+	run_pipeline(state, [&] (rethread::pipeline<timed_item>& p, const rethread::cancellation_token& token)
+	{
+		for (size_t i = 0; i < ItemsPerIteration; ++i)
+		{
+			batch.push_back(timed_item{std::chrono::steady_clock::now(), 0});
+			if (batch.size() == BatchSize)
+				p.push(batch, token);
+		}
+		if (!batch.empty())
+			p.push(batch, token);
+	});
+}
+BENCHMARK(pipeline_batched_input)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
@@ -0,0 +1,127 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#if defined(RETHREAD_HAS_POLL) && defined(__linux__)
+
+#include <rethread_ext/process.hpp>
+
+#include <pthread.h>
+
+#include <chrono>
+#include <system_error>
+#include <thread>
+
+
+// Every iteration forks a child that exits (or signals the parent) right away, so the time includes fork and exit.
+// The difference between the pidfd/signalfd and the sleep-poll variants is the reaction latency
+
+namespace
+{
+	pid_t fork_exiting_child()
+	{
+		pid_t pid = ::fork();
+		RETHREAD_CHECK(pid != -1, std::system_error(errno, std::system_category()));
+		if (pid == 0)
+			::_exit(0);
+		return pid;
+	}
+
+	pid_t fork_signalling_child(pid_t parent, pid_t tid, int signo)
+	{
+		pid_t pid = ::fork();
+		RETHREAD_CHECK(pid != -1, std::system_error(errno, std::system_category()));
+		if (pid == 0)
+			::_exit((int)::syscall(SYS_tgkill, parent, tid, signo));
+		return pid;
+	}
+
+	class blocked_signal
+	{
+		sigset_t _signals;
+		sigset_t _old;
+
+	public:
+		explicit blocked_signal(int signo)
+		{
+			sigemptyset(&_signals);
+			sigaddset(&_signals, signo);
+			::pthread_sigmask(SIG_BLOCK, &_signals, &_old);
+		}
+
+		~blocked_signal()
+		{ ::pthread_sigmask(SIG_SETMASK, &_old, nullptr); }
+
+		const sigset_t& signals() const
+		{ return _signals; }
+	};
+}
+
+
+static void child_exit_pidfd(benchmark::State& state)
+{
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(rethread::wait_child(fork_exiting_child(), token));
+}
+BENCHMARK(child_exit_pidfd)->UseRealTime();
+
+
+/// @brief Arg is the sleep interval in microseconds
+static void child_exit_sleep_poll(benchmark::State& state)
+{
+	const std::chrono::microseconds interval(state.range_x());
+	while (state.KeepRunning())
+	{
+		pid_t pid = fork_exiting_child();
+		int status = 0;
+		while (::waitpid(pid, &status, WNOHANG) == 0)
+			std::this_thread::sleep_for(interval);
+		benchmark::DoNotOptimize(status);
+	}
+}
+BENCHMARK(child_exit_sleep_poll)->Arg(100)->Arg(1000)->Arg(10000)->UseRealTime();
+
+
+static void signal_signalfd(benchmark::State& state)
+{
+	blocked_signal blocked(SIGUSR1);
+	const pid_t parent = ::getpid();
+	const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+	{
+		pid_t pid = fork_signalling_child(parent, tid, SIGUSR1);
+		benchmark::DoNotOptimize(rethread::wait_signal(blocked.signals(), token));
+		::waitpid(pid, nullptr, 0);
+	}
+}
+BENCHMARK(signal_signalfd)->UseRealTime();
+
+
+/// @brief Arg is the sleep interval in microseconds
+static void signal_sleep_poll(benchmark::State& state)
+{
+	blocked_signal blocked(SIGUSR1);
+	const pid_t parent = ::getpid();
+	const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+	const std::chrono::microseconds interval(state.range_x());
+	const timespec no_wait = { 0, 0 };
+	while (state.KeepRunning())
+	{
+		pid_t pid = fork_signalling_child(parent, tid, SIGUSR1);
+		while (::sigtimedwait(&blocked.signals(), nullptr, &no_wait) == -1)
+			std::this_thread::sleep_for(interval);
+		::waitpid(pid, nullptr, 0);
+	}
+}
+BENCHMARK(signal_sleep_poll)->Arg(100)->Arg(1000)->Arg(10000)->UseRealTime();
+
+#endif
@@ -0,0 +1,155 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/resource_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+	/// @brief The usual pool: one condition_variable, notify_all on every release
+	class cv_pool
+	{
+		std::mutex              _mutex;
+		std::condition_variable _cv;
+		std::vector<int>        _free;
+
+	public:
+		explicit cv_pool(size_t size)
+		{
+			for (size_t i = 0; i < size; ++i)
+				_free.push_back(static_cast<int>(i));
+		}
+
+		int acquire(const rethread::cancellation_token& token)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			if (!rethread::wait(_cv, l, token, [this] { return !_free.empty(); }))
+				return -1;
+			int result = _free.back();
+			_free.pop_back();
+			return result;
+		}
+
+		void release(int resource)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_free.push_back(resource);
+			_cv.notify_all();
+		}
+	};
+
+
+	std::vector<int> make_resources(size_t size)
+	{
+		std::vector<int> result;
+		for (size_t i = 0; i < size; ++i)
+			result.push_back(static_cast<int>(i));
+		return result;
+	}
+
+
+	static const size_t PoolSize = 4;
+	static const int FairnessThreads = 64;
+	static const int FairnessAcquisitions = FairnessThreads * 100;
+
+
+	/// @brief Runs FairnessThreads threads that share a budget of acquisitions, reports the spread of per-thread shares
+	template <typename Acquire_>
+	void run_fairness(benchmark::State& state, const Acquire_& acquire_and_release)
+	{
+		int min_share = FairnessAcquisitions;
+		int max_share = 0;
+		while (state.KeepRunning())
+		{
+			std::atomic<int> budget{FairnessAcquisitions};
+			std::vector<int> shares(FairnessThreads, 0);
+			std::vector<std::thread> workers;
+			for (int i = 0; i < FairnessThreads; ++i)
+				workers.emplace_back([&, i]
+				{
+					while (budget.fetch_sub(1, std::memory_order_relaxed) > 0)
+					{
+						acquire_and_release();
+						++shares[i];
+					}
+				});
+			for (size_t i = 0; i < workers.size(); ++i)
+				workers[i].join();
+
+			min_share = std::min(min_share, *std::min_element(shares.begin(), shares.end()));
+			max_share = std::max(max_share, *std::max_element(shares.begin(), shares.end()));
+		}
+		state.SetItemsProcessed(state.iterations() * FairnessAcquisitions);
+		state.SetLabel("per-thread share " + std::to_string(min_share) + ".." + std::to_string(max_share) + ", fair " + std::to_string(FairnessAcquisitions / FairnessThreads));
+	}
+}
+
+
+static void resource_pool_throughput(benchmark::State& state)
+{
+	static rethread::resource_pool<int> pool(make_resources(PoolSize));
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+	{
+		rethread::resource_pool<int>::handle h = pool.acquire(token);
+		benchmark::DoNotOptimize(*h);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(resource_pool_throughput)->ThreadRange(1, 64)->UseRealTime();
+
+
+static void cv_pool_throughput(benchmark::State& state)
+{
+	static cv_pool pool(PoolSize);
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+	{
+		int resource = pool.acquire(token);
+		benchmark::DoNotOptimize(resource);
+		pool.release(resource);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(cv_pool_throughput)->ThreadRange(1, 64)->UseRealTime();
+
+
+static void resource_pool_fairness(benchmark::State& state)
+{
+	rethread::resource_pool<int> pool(make_resources(PoolSize));
+	run_fairness(state, [&pool]
+	{
+		rethread::standalone_cancellation_token token;
+		rethread::resource_pool<int>::handle h = pool.acquire(token);
+		std::this_thread::yield();
+	});
+}
+BENCHMARK(resource_pool_fairness)->UseRealTime();
+
+
+static void cv_pool_fairness(benchmark::State& state)
+{
+	cv_pool pool(PoolSize);
+	run_fairness(state, [&pool]
+	{
+		rethread::standalone_cancellation_token token;
+		int resource = pool.acquire(token);
+		std::this_thread::yield();
+		pool.release(resource);
+	});
+}
+BENCHMARK(cv_pool_fairness)->UseRealTime();
@@ -0,0 +1,372 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/compact_cancellation_token.hpp>
+#include <rethread_ext/thread_cache.hpp>
+
+#if defined(RETHREAD_HAS_POLL)
+#	include <rethread/poll.hpp>
+#	include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#	include <pthread.h>
+#	include <sched.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+// Contention and scaling: every case runs on 1..64 threads at once, with real primitives instead of the mocks.
+// The label shows the throughput of all the threads divided by the number of cores they could run on.
+// Set RETHREAD_BENCHMARK_PIN_THREADS=1 to pin the N-th benchmark thread to the N-th allowed CPU, wrapping around when there are more threads than CPUs (Linux only)
+
+namespace
+{
+	std::vector<int> get_allowed_cpus()
+	{
+		std::vector<int> result;
+#if defined(__linux__)
+		cpu_set_t set;
+		if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+				if (CPU_ISSET(cpu, &set))
+					result.push_back(cpu);
+#endif
+		return result;
+	}
+
+
+	/// @returns Whether RETHREAD_BENCHMARK_PIN_THREADS is set to anything but an empty string or 0
+	bool pin_threads_requested()
+	{
+		const char* value = std::getenv("RETHREAD_BENCHMARK_PIN_THREADS");
+		return value && *value && std::strcmp(value, "0") != 0;
+	}
+
+
+	// Taken before any benchmark thread is pinned
+	const std::vector<int> AllowedCpus = get_allowed_cpus();
+	const int AvailableCpus = AllowedCpus.empty() ? std::max(1, static_cast<int>(std::thread::hardware_concurrency())) : static_cast<int>(AllowedCpus.size());
+	const bool PinThreads = pin_threads_requested();
+
+
+	/// @brief Pins the calling thread for the lifetime of the object, if enabled
+	class thread_pinning
+	{
+#if defined(__linux__)
+		cpu_set_t _old;
+#endif
+		bool      _pinned{false};
+
+	public:
+		explicit thread_pinning(int index)
+		{
+#if defined(__linux__)
+			if (!PinThreads || AllowedCpus.empty() || ::pthread_getaffinity_np(::pthread_self(), sizeof(_old), &_old) != 0)
+				return;
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(AllowedCpus[index % AllowedCpus.size()], &set);
+			_pinned = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+			(void)index;
+#endif
+		}
+
+		thread_pinning(const thread_pinning&) = delete;
+		thread_pinning& operator =(const thread_pinning&) = delete;
+
+		~thread_pinning()
+		{
+#if defined(__linux__)
+			if (_pinned)
+				::pthread_setaffinity_np(::pthread_self(), sizeof(_old), &_old);
+#endif
+		}
+
+		bool pinned() const
+		{ return _pinned; }
+	};
+
+
+	std::string format_rate(double rate)
+	{
+		static const char* const suffixes[] = { "", "k", "M", "G" };
+		size_t i = 0;
+		for (; rate >= 1000 && i + 1 < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+			rate /= 1000;
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%.3g%s/s", rate, suffixes[i]);
+		return buf;
+	}
+
+
+	/// @brief Replaces state.KeepRunning(), measures the time between the first and the last iteration for the per-core label
+	class scaling_run
+	{
+		benchmark::State&                     _state;
+		thread_pinning                        _pinning;
+		bool                                  _started{false};
+		std::chrono::steady_clock::time_point _start;
+		std::chrono::steady_clock::time_point _end;
+
+	public:
+		explicit scaling_run(benchmark::State& state) :
+			_state(state), _pinning(state.thread_index)
+		{ }
+
+		bool keep_running()
+		{
+			bool result = _state.KeepRunning();
+			if (!_started)
+			{
+				_started = true;
+				_start = std::chrono::steady_clock::now();
+			}
+			if (!result)
+				_end = std::chrono::steady_clock::now();
+			return result;
+		}
+
+		void finish()
+		{
+			_state.SetItemsProcessed(_state.iterations());
+			report(_state.threads);
+		}
+
+		/// @param total_items_per_iteration Items processed by all the threads together in one iteration
+		/// @details Assumes that the threads ran for roughly the same time, only the first one sets the label
+		void report(int total_items_per_iteration)
+		{
+			double seconds = std::chrono::duration<double>(_end - _start).count();
+			if (_state.thread_index != 0 || seconds <= 0)
+				return;
+			double total = static_cast<double>(_state.iterations()) * total_items_per_iteration / seconds;
+			_state.SetLabel(format_rate(total / std::min(_state.threads, AvailableCpus)) + " per core" + (_pinning.pinned() ? ", pinned" : ""));
+		}
+	};
+
+
+	/// @brief Reusable barrier for the benchmark threads
+	class barrier
+	{
+		std::mutex              _mutex;
+		std::condition_variable _cv;
+		int                     _waiting{0};
+		size_t                  _generation{0};
+
+	public:
+		void wait(int count)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			size_t generation = _generation;
+			if (++_waiting == count)
+			{
+				_waiting = 0;
+				++_generation;
+				_cv.notify_all();
+				return;
+			}
+			while (generation == _generation)
+				_cv.wait(l);
+		}
+	};
+
+
+	struct empty_handler : public rethread::cancellation_handler
+	{
+		void cancel() override { }
+	};
+
+
+	/// @brief Calls the function with a token created on the stack
+	template <typename Token_>
+	struct token_factory
+	{
+		template <typename Func_>
+		void use(const Func_& func)
+		{
+			Token_ token;
+			func(token);
+		}
+	};
+
+
+	/// @brief All the tokens come from one source, shared by the threads
+	template <>
+	struct token_factory<rethread::sourced_cancellation_token>
+	{
+		rethread::cancellation_token_source _source;
+
+		template <typename Func_>
+		void use(const Func_& func)
+		{
+			rethread::sourced_cancellation_token token = _source.create_token();
+			func(token);
+		}
+	};
+}
+
+
+template <typename Token_>
+static void scaling_create_token(benchmark::State& state)
+{
+	static token_factory<Token_> factory;
+	scaling_run run(state);
+	while (run.keep_running())
+		factory.use([] (Token_& token) { benchmark::DoNotOptimize(&token); });
+	run.finish();
+}
+BENCHMARK_TEMPLATE(scaling_create_token, rethread::standalone_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(scaling_create_token, rethread::compact_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(scaling_create_token, rethread::sourced_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+
+
+template <typename Token_>
+static void scaling_guard(benchmark::State& state)
+{
+	static token_factory<Token_> factory;
+	empty_handler handler;
+	scaling_run run(state);
+	factory.use([&] (Token_& token)
+	{
+		while (run.keep_running())
+		{
+			rethread::cancellation_guard guard(token, handler);
+			benchmark::DoNotOptimize(guard.is_cancelled());
+		}
+	});
+	run.finish();
+}
+BENCHMARK_TEMPLATE(scaling_guard, rethread::standalone_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(scaling_guard, rethread::compact_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(scaling_guard, rethread::sourced_cancellation_token)->ThreadRange(1, 64)->UseRealTime();
+
+
+/// @brief The first thread cancels a source, the others wait in rethread::wait on its tokens. Items are the woken up waiters
+/// @details A waiter counts itself in the first call of the predicate, under its mutex. The mutex is only released inside cv.wait(),
+/// i.e. once the cancellation guard is registered, so after taking every waiter's mutex the first thread cancels registered waiters only
+static void scaling_cancel_waiters(benchmark::State& state)
+{
+	struct waiter
+	{
+		std::mutex              mutex;
+		std::condition_variable cv;
+	};
+
+	static barrier sync;
+	static std::unique_ptr<rethread::cancellation_token_source> source;
+	static std::atomic<int> registered{0};
+	static std::array<waiter, 64> waiters;
+
+	waiter& self = waiters[state.thread_index];
+	scaling_run run(state);
+	while (run.keep_running())
+	{
+		if (state.thread_index == 0)
+		{
+			source.reset(new rethread::cancellation_token_source);
+			registered = 0;
+		}
+		sync.wait(state.threads);
+
+		if (state.thread_index == 0)
+		{
+			while (registered != state.threads - 1)
+				std::this_thread::yield();
+			for (int i = 1; i < state.threads; ++i)
+				std::lock_guard<std::mutex> l(waiters[i].mutex);
+			source->cancel();
+		}
+		else
+		{
+			rethread::sourced_cancellation_token token = source->create_token();
+			std::unique_lock<std::mutex> l(self.mutex);
+			bool counted = false;
+			rethread::wait(self.cv, l, token, [&counted]
+			{
+				if (!counted)
+				{
+					counted = true;
+					++registered;
+				}
+				return false;
+			});
+		}
+		sync.wait(state.threads);
+	}
+	state.SetItemsProcessed(state.thread_index == 0 ? 0 : state.iterations());
+	run.report(state.threads - 1);
+}
+BENCHMARK(scaling_cancel_waiters)->ThreadRange(2, 64)->UseRealTime();
+
+
+#if defined(RETHREAD_HAS_POLL)
+/// @brief Every thread polls its own pipe, which always has data
+static void scaling_poll(benchmark::State& state)
+{
+	int fds[2];
+	RETHREAD_CHECK(::pipe(fds) == 0, std::system_error(errno, std::system_category()));
+	char dummy = 0;
+	RETHREAD_CHECK(::write(fds[1], &dummy, 1) == 1, std::system_error(errno, std::system_category()));
+
+	rethread::standalone_cancellation_token token;
+	scaling_run run(state);
+	while (run.keep_running())
+		benchmark::DoNotOptimize(rethread::poll(fds[0], POLLIN, token));
+	run.finish();
+
+	::close(fds[0]);
+	::close(fds[1]);
+}
+BENCHMARK(scaling_poll)->ThreadRange(1, 64)->UseRealTime();
+#endif
+
+
+static void scaling_thread_start_reset(benchmark::State& state)
+{
+	scaling_run run(state);
+	while (run.keep_running())
+	{
+		rethread::thread t([] (const rethread::cancellation_token& token) { while (token) token.sleep_for(std::chrono::hours(1)); });
+		t.reset();
+	}
+	run.finish();
+}
+BENCHMARK(scaling_thread_start_reset)->ThreadRange(1, 64)->UseRealTime();
+
+
+static void scaling_cached_thread_start_reset(benchmark::State& state)
+{
+	scaling_run run(state);
+	while (run.keep_running())
+	{
+		rethread::cached_thread t([] (const rethread::cancellation_token& token) { while (token) token.sleep_for(std::chrono::hours(1)); });
+		t.reset();
+	}
+	run.finish();
+}
+BENCHMARK(scaling_cached_thread_start_reset)->ThreadRange(1, 64)->UseRealTime();
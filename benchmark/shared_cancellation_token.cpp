@@ -0,0 +1,153 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#if defined(__linux__)
+
+#include <rethread/condition_variable.hpp>
+#include <rethread_ext/shared_cancellation_token.hpp>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+
+
+// Every iteration is a round trip: the parent wakes a child process up, the child wakes the parent up in return.
+// The child is forked once per benchmark and only uses async-signal-safe calls
+
+namespace
+{
+	enum shared_states { Request, Response, Stop, StatesCount };
+
+
+	/// @brief Child that answers every cancellation of the Request state by cancelling the Response state
+	pid_t fork_responder(rethread::shared_cancellation_segment& segment)
+	{
+		pid_t pid = ::fork();
+		RETHREAD_CHECK(pid != -1, std::system_error(errno, std::system_category()));
+		if (pid != 0)
+			return pid;
+
+		while (true)
+		{
+			segment[Request].wait_for(std::chrono::hours(1));
+			if (segment[Stop].is_cancelled())
+				::_exit(0);
+			segment[Request].reset();
+			segment[Response].cancel();
+		}
+	}
+
+
+	void stop_responder(rethread::shared_cancellation_segment& segment, pid_t pid)
+	{
+		segment[Stop].cancel();
+		segment[Request].cancel();
+		::waitpid(pid, nullptr, 0);
+	}
+
+
+	class blocked_signals
+	{
+		sigset_t _old;
+
+	public:
+		explicit blocked_signals(const sigset_t& signals)
+		{ ::pthread_sigmask(SIG_BLOCK, &signals, &_old); }
+
+		~blocked_signals()
+		{ ::pthread_sigmask(SIG_SETMASK, &_old, nullptr); }
+	};
+}
+
+
+/// @brief The parent waits for the response on the futex, like the child
+static void shared_state_round_trip(benchmark::State& state)
+{
+	rethread::shared_cancellation_segment segment(StatesCount);
+	pid_t pid = fork_responder(segment);
+	while (state.KeepRunning())
+	{
+		segment[Request].cancel();
+		segment[Response].wait_for(std::chrono::hours(1));
+		segment[Response].reset();
+	}
+	stop_responder(segment, pid);
+}
+BENCHMARK(shared_state_round_trip)->UseRealTime();
+
+
+/// @brief The parent waits for the response in rethread::wait, i.e. through the watcher thread of the token and a condition variable
+static void shared_token_wait_round_trip(benchmark::State& state)
+{
+	rethread::shared_cancellation_segment segment(StatesCount);
+	pid_t pid = fork_responder(segment);
+	{
+		rethread::shared_cancellation_token response(segment[Response]);
+		std::mutex m;
+		std::condition_variable cv;
+		while (state.KeepRunning())
+		{
+			segment[Request].cancel();
+			{
+				std::unique_lock<std::mutex> l(m);
+				rethread::wait(cv, l, response, [] { return false; });
+			}
+			response.reset();
+		}
+	}
+	stop_responder(segment, pid);
+}
+BENCHMARK(shared_token_wait_round_trip)->UseRealTime();
+
+
+/// @brief The usual approach: SIGUSR1 to the child, SIGUSR2 back to the benchmark thread, both taken with sigwaitinfo
+static void signal_round_trip(benchmark::State& state)
+{
+	sigset_t request, response, both;
+	sigemptyset(&request);
+	sigaddset(&request, SIGUSR1);
+	sigemptyset(&response);
+	sigaddset(&response, SIGUSR2);
+	sigemptyset(&both);
+	sigaddset(&both, SIGUSR1);
+	sigaddset(&both, SIGUSR2);
+
+	blocked_signals blocked(both);
+	const pid_t parent = ::getpid();
+	const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+
+	pid_t pid = ::fork();
+	RETHREAD_CHECK(pid != -1, std::system_error(errno, std::system_category()));
+	if (pid == 0)
+	{
+		while (true)
+			if (::sigwaitinfo(&request, nullptr) == SIGUSR1)
+				::syscall(SYS_tgkill, parent, tid, SIGUSR2);
+	}
+
+	while (state.KeepRunning())
+	{
+		::kill(pid, SIGUSR1);
+		while (::sigwaitinfo(&response, nullptr) != SIGUSR2)
+			;
+	}
+
+	::kill(pid, SIGKILL);
+	::waitpid(pid, nullptr, 0);
+}
+BENCHMARK(signal_round_trip)->UseRealTime();
+
+#endif
@@ -0,0 +1,198 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#if defined(RETHREAD_HAS_POLL) && defined(__linux__)
+
+#include <rethread_ext/splice.hpp>
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+// Moves range_x() bytes from a (sparse, so cached) file into a pipe or a socketpair per iteration.
+// A sink thread drains the other end with read() in all the variants, so the differences come from the sending side
+
+namespace
+{
+	class source_file
+	{
+		int _fd;
+
+	public:
+		explicit source_file(size_t size)
+		{
+			char path[] = "/tmp/rethread_splice_benchmark_XXXXXX";
+			_fd = ::mkstemp(path);
+			RETHREAD_CHECK(_fd != -1, std::system_error(errno, std::system_category()));
+			::unlink(path);
+			RETHREAD_CHECK(::ftruncate(_fd, static_cast<off_t>(size)) == 0, std::system_error(errno, std::system_category()));
+		}
+
+		source_file(const source_file&) = delete;
+		source_file& operator =(const source_file&) = delete;
+
+		~source_file()
+		{ ::close(_fd); }
+
+		int rewind()
+		{
+			::lseek(_fd, 0, SEEK_SET);
+			return _fd;
+		}
+	};
+
+
+	class draining_sink
+	{
+		int                        _fds[2];
+		std::atomic<std::uint64_t> _received{0};
+		std::thread                _thread;
+
+	public:
+		explicit draining_sink(bool socket)
+		{
+			if (socket)
+				RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, _fds) == 0, std::system_error(errno, std::system_category()));
+			else
+				RETHREAD_CHECK(::pipe(_fds) == 0, std::system_error(errno, std::system_category()));
+			::fcntl(_fds[1], F_SETFL, ::fcntl(_fds[1], F_GETFL) | O_NONBLOCK);
+
+			_thread = std::thread([this]
+			{
+				std::vector<char> buf(1 << 20);
+				ssize_t result;
+				while ((result = ::read(_fds[0], buf.data(), buf.size())) > 0 || (result == -1 && errno == EINTR))
+					if (result > 0)
+						_received.fetch_add(static_cast<std::uint64_t>(result), std::memory_order_release);
+			});
+		}
+
+		draining_sink(const draining_sink&) = delete;
+		draining_sink& operator =(const draining_sink&) = delete;
+
+		~draining_sink()
+		{
+			::close(_fds[1]);
+			_thread.join();
+			::close(_fds[0]);
+		}
+
+		int fd() const
+		{ return _fds[1]; }
+
+		void wait_received(std::uint64_t total)
+		{
+			while (_received.load(std::memory_order_acquire) < total)
+				std::this_thread::yield();
+		}
+	};
+
+
+	ssize_t read_write_loop(int in_fd, int out_fd, size_t count, std::vector<char>& buf, const rethread::cancellation_token& token)
+	{
+		size_t transferred = 0;
+		while (transferred < count)
+		{
+			ssize_t result = rethread::read(in_fd, buf.data(), std::min(buf.size(), count - transferred), token);
+			if (result <= 0)
+				break;
+			for (ssize_t written = 0; written < result; )
+			{
+				ssize_t w = rethread::write(out_fd, buf.data() + written, static_cast<size_t>(result - written), token);
+				if (w < 0)
+					return -1;
+				written += w;
+			}
+			transferred += static_cast<size_t>(result);
+		}
+		return static_cast<ssize_t>(transferred);
+	}
+
+
+	enum class transfer_method { read_write, splice, sendfile };
+
+	template <transfer_method Method_>
+	void transfer_file(benchmark::State& state, bool socket)
+	{
+		const size_t size = static_cast<size_t>(state.range_x());
+		source_file file(size);
+		draining_sink sink(socket);
+		std::vector<char> buf(1 << 16);
+		rethread::standalone_cancellation_token token;
+
+		std::uint64_t total = 0;
+		while (state.KeepRunning())
+		{
+			int in_fd = file.rewind();
+			ssize_t result = 0;
+			if (Method_ == transfer_method::read_write)
+				result = read_write_loop(in_fd, sink.fd(), size, buf, token);
+			else if (Method_ == transfer_method::splice)
+			{
+				size_t stranded = 0;
+				result = rethread::splice(in_fd, sink.fd(), size, token, stranded);
+			}
+			else
+			{
+				off_t offset = 0;
+				result = rethread::sendfile(sink.fd(), in_fd, &offset, size, token);
+			}
+
+			if (result != static_cast<ssize_t>(size))
+			{
+				state.SkipWithError("Transfer failed");
+				break;
+			}
+			total += size;
+			sink.wait_received(total);
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(total));
+	}
+}
+
+
+static void file_to_pipe_read_write(benchmark::State& state)
+{ transfer_file<transfer_method::read_write>(state, false); }
+BENCHMARK(file_to_pipe_read_write)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+
+static void file_to_pipe_splice(benchmark::State& state)
+{ transfer_file<transfer_method::splice>(state, false); }
+BENCHMARK(file_to_pipe_splice)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+
+static void file_to_pipe_sendfile(benchmark::State& state)
+{ transfer_file<transfer_method::sendfile>(state, false); }
+BENCHMARK(file_to_pipe_sendfile)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+
+static void file_to_socket_read_write(benchmark::State& state)
+{ transfer_file<transfer_method::read_write>(state, true); }
+BENCHMARK(file_to_socket_read_write)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+
+static void file_to_socket_splice(benchmark::State& state)
+{ transfer_file<transfer_method::splice>(state, true); }
+BENCHMARK(file_to_socket_splice)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+
+static void file_to_socket_sendfile(benchmark::State& state)
+{ transfer_file<transfer_method::sendfile>(state, true); }
+BENCHMARK(file_to_socket_sendfile)->Range(4 << 10, 1 << 30)->UseRealTime();
+
+#endif
@@ -0,0 +1,119 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/thread_cache.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+
+// Construct-run-reset cycles. The *_cancel variants run until the token is cancelled, so reset() has to cancel and wake the function
+
+namespace
+{
+	void run_once(std::atomic<int>& counter, const rethread::cancellation_token&)
+	{ counter.fetch_add(1, std::memory_order_relaxed); }
+
+	void run_until_cancelled(std::atomic<int>& counter, const rethread::cancellation_token& token)
+	{
+		counter.fetch_add(1, std::memory_order_relaxed);
+		while (token)
+			token.sleep_for(std::chrono::hours(1));
+	}
+}
+
+
+static void thread_construct_reset(benchmark::State& state)
+{
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		rethread::thread t(&run_once, std::ref(counter));
+		t.reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(thread_construct_reset)->UseRealTime();
+
+
+static void cached_thread_construct_reset(benchmark::State& state)
+{
+	rethread::thread_cache cache(1);
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		rethread::cached_thread t(cache, &run_once, std::ref(counter));
+		t.reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(cached_thread_construct_reset)->UseRealTime();
+
+
+static void thread_construct_cancel(benchmark::State& state)
+{
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		rethread::thread t(&run_until_cancelled, std::ref(counter));
+		t.reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(thread_construct_cancel)->UseRealTime();
+
+
+static void cached_thread_construct_cancel(benchmark::State& state)
+{
+	rethread::thread_cache cache(1);
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		rethread::cached_thread t(cache, &run_until_cancelled, std::ref(counter));
+		t.reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(cached_thread_construct_cancel)->UseRealTime();
+
+
+/// @brief Arg threads are started before any of them is reset, the cache keeps that many
+static void thread_construct_reset_batch(benchmark::State& state)
+{
+	const size_t count = static_cast<size_t>(state.range_x());
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		std::vector<rethread::thread> batch;
+		for (size_t i = 0; i < count; ++i)
+			batch.push_back(rethread::thread(&run_until_cancelled, std::ref(counter)));
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(thread_construct_reset_batch)->Arg(8)->Arg(64)->UseRealTime();
+
+
+static void cached_thread_construct_reset_batch(benchmark::State& state)
+{
+	const size_t count = static_cast<size_t>(state.range_x());
+	rethread::thread_cache cache(count);
+	std::atomic<int> counter{0};
+	while (state.KeepRunning())
+	{
+		std::vector<rethread::cached_thread> batch;
+		for (size_t i = 0; i < count; ++i)
+			batch.push_back(rethread::cached_thread(cache, &run_until_cancelled, std::ref(counter)));
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(cached_thread_construct_reset_batch)->Arg(8)->Arg(64)->UseRealTime();
@@ -0,0 +1,169 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/timed_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+
+namespace
+{
+	struct timed_cv_mock
+	{
+		void notify_all() { }
+
+		template <typename Clock_, typename Duration_>
+		std::cv_status wait_until(std::unique_lock<mutex_mock>& l, const std::chrono::time_point<Clock_, Duration_>&)
+		{
+			benchmark::DoNotOptimize(&l);
+			return std::cv_status::no_timeout;
+		}
+	};
+
+
+	template <typename Condition_, typename Lock_>
+	struct notifying_handler : public rethread::cancellation_handler
+	{
+		Condition_& cv;
+		Lock_&      lock;
+
+		notifying_handler(Condition_& cv, Lock_& lock) : cv(cv), lock(lock) { }
+
+		void cancel() override
+		{
+			std::unique_lock<typename Lock_::mutex_type> l(*lock.mutex());
+			cv.notify_all();
+		}
+	};
+
+
+	/// @brief What the code does without timed waits: every wakeup registers and unregisters the handler again
+	template <typename Condition_, typename Lock_, typename Predicate_>
+	rethread::wait_result rewrapped_wait_until(Condition_& cv, Lock_& lock, std::chrono::steady_clock::time_point deadline, const rethread::cancellation_token& token, Predicate_ pred)
+	{
+		notifying_handler<Condition_, Lock_> handler(cv, lock);
+		while (!pred())
+		{
+			std::cv_status status;
+			{
+				rethread::cancellation_guard guard(token, handler);
+				if (guard.is_cancelled())
+					return rethread::wait_result::cancelled;
+				status = cv.wait_until(lock, deadline);
+				lock.unlock();
+			}
+			lock.lock();
+			if (status == std::cv_status::timeout)
+				return pred() ? rethread::wait_result::ready : rethread::wait_result::timeout;
+		}
+		return rethread::wait_result::ready;
+	}
+}
+
+
+/// @brief Arg is the number of wakeups before the predicate is satisfied
+static void timed_wait_registered_once(benchmark::State& state)
+{
+	timed_cv_mock cv;
+	mutex_mock m;
+	std::unique_lock<mutex_mock> l(m);
+	rethread::standalone_cancellation_token token;
+	const int wakeups = static_cast<int>(state.range_x());
+	while (state.KeepRunning())
+	{
+		int count = 0;
+		benchmark::DoNotOptimize(rethread::wait_for(cv, l, std::chrono::seconds(1), token, [&count, wakeups] { return count++ == wakeups; }));
+	}
+}
+BENCHMARK(timed_wait_registered_once)->Arg(1)->Arg(16);
+
+
+static void timed_wait_rewrapped(benchmark::State& state)
+{
+	timed_cv_mock cv;
+	mutex_mock m;
+	std::unique_lock<mutex_mock> l(m);
+	rethread::standalone_cancellation_token token;
+	const int wakeups = static_cast<int>(state.range_x());
+	while (state.KeepRunning())
+	{
+		int count = 0;
+		benchmark::DoNotOptimize(rewrapped_wait_until(cv, l, std::chrono::steady_clock::now() + std::chrono::seconds(1), token, [&count, wakeups] { return count++ == wakeups; }));
+	}
+}
+BENCHMARK(timed_wait_rewrapped)->Arg(1)->Arg(16);
+
+
+/// @brief Cancellation latency of a waiter that only checks the token on a heartbeat, like old_concurrent_queue does. Arg is the heartbeat in microseconds
+static void timed_wait_heartbeat_cancel_latency(benchmark::State& state)
+{
+	const std::chrono::microseconds heartbeat(state.range_x());
+	std::chrono::nanoseconds latency(0);
+	while (state.KeepRunning())
+	{
+		std::mutex m;
+		std::condition_variable cv;
+		rethread::standalone_cancellation_token token;
+		std::atomic<bool> waiting{false};
+		std::chrono::steady_clock::time_point woken;
+		std::thread t([&]
+		{
+			std::unique_lock<std::mutex> l(m);
+			waiting = true;
+			while (token)
+				cv.wait_for(l, heartbeat);
+			woken = std::chrono::steady_clock::now();
+		});
+		while (!waiting)
+			std::this_thread::yield();
+
+		std::chrono::steady_clock::time_point cancelled = std::chrono::steady_clock::now();
+		token.cancel();
+		t.join();
+		latency += woken - cancelled;
+	}
+	state.SetLabel("mean latency " + std::to_string(latency.count() / state.iterations()) + " ns");
+}
+BENCHMARK(timed_wait_heartbeat_cancel_latency)->Arg(100)->Arg(1000)->Arg(100000)->UseRealTime();
+
+
+static void timed_wait_cancel_latency(benchmark::State& state)
+{
+	std::chrono::nanoseconds latency(0);
+	while (state.KeepRunning())
+	{
+		std::mutex m;
+		std::condition_variable cv;
+		rethread::standalone_cancellation_token token;
+		std::atomic<bool> waiting{false};
+		std::chrono::steady_clock::time_point woken;
+		std::thread t([&]
+		{
+			std::unique_lock<std::mutex> l(m);
+			waiting = true;
+			while (rethread::wait_for(cv, l, std::chrono::seconds(10), token) != rethread::wait_result::cancelled)
+				;
+			woken = std::chrono::steady_clock::now();
+		});
+		while (!waiting)
+			std::this_thread::yield();
+
+		std::chrono::steady_clock::time_point cancelled = std::chrono::steady_clock::now();
+		token.cancel();
+		t.join();
+		latency += woken - cancelled;
+	}
+	state.SetLabel("mean latency " + std::to_string(latency.count() / state.iterations()) + " ns");
+}
+BENCHMARK(timed_wait_cancel_latency)->UseRealTime();
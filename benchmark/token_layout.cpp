@@ -0,0 +1,84 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/compact_cancellation_token.hpp>
+
+#include <string>
+
+
+static RETHREAD_CONSTEXPR int MaxNeighbourThreads = 32;
+
+
+// Static storage, because C++11 operator new doesn't respect cache line alignment of padded tokens
+template <typename Token_>
+struct neighbour_tokens
+{
+	static Token_ tokens[MaxNeighbourThreads];
+};
+
+template <typename Token_>
+Token_ neighbour_tokens<Token_>::tokens[MaxNeighbourThreads];
+
+
+template <typename Token_>
+static std::string token_size_label()
+{ return std::to_string(sizeof(Token_)) + " bytes per token"; }
+
+
+// Every thread cancels and resets its own token
+template <typename Token_>
+static void neighbour_tokens_cancel(benchmark::State& state)
+{
+	Token_& token = neighbour_tokens<Token_>::tokens[state.thread_index];
+	while (state.KeepRunning())
+	{
+		token.cancel();
+		benchmark::DoNotOptimize(token.is_cancelled());
+		token.reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+	if (state.thread_index == 0)
+		state.SetLabel(token_size_label<Token_>());
+}
+BENCHMARK_TEMPLATE(neighbour_tokens_cancel, rethread::standalone_cancellation_token)->ThreadRange(1, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_cancel, rethread::padded_standalone_cancellation_token)->ThreadRange(1, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_cancel, rethread::compact_cancellation_token)->ThreadRange(1, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_cancel, rethread::padded_compact_cancellation_token)->ThreadRange(1, MaxNeighbourThreads);
+
+
+// Even threads cancel and reset their tokens, odd threads poll theirs, which share cache lines with the neighbours unless padded
+template <typename Token_>
+static void neighbour_tokens_poll(benchmark::State& state)
+{
+	Token_& token = neighbour_tokens<Token_>::tokens[state.thread_index];
+	bool cancelling = state.thread_index % 2 == 0;
+	while (state.KeepRunning())
+	{
+		if (cancelling)
+		{
+			token.cancel();
+			token.reset();
+		}
+		else
+		{
+			RETHREAD_CONSTEXPR size_t Count = 10;
+			for (size_t i = 0; i < Count; ++i)
+				benchmark::DoNotOptimize(token.is_cancelled());
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	if (state.thread_index == 0)
+		state.SetLabel(token_size_label<Token_>());
+}
+BENCHMARK_TEMPLATE(neighbour_tokens_poll, rethread::standalone_cancellation_token)->ThreadRange(2, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_poll, rethread::padded_standalone_cancellation_token)->ThreadRange(2, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_poll, rethread::compact_cancellation_token)->ThreadRange(2, MaxNeighbourThreads);
+BENCHMARK_TEMPLATE(neighbour_tokens_poll, rethread::padded_compact_cancellation_token)->ThreadRange(2, MaxNeighbourThreads);
@@ -0,0 +1,161 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/trace.hpp>
+
+#include <string>
+
+
+// Follows the build: with scons TRACING=1 the traced_* cases record at the sample rates given as Arg,
+// otherwise they run the compiled-out rethread::traced wrappers. The *_plain cases call rethread directly for reference
+
+#if defined(RETHREAD_TRACING)
+	// 0 - tracing is off at runtime, 1 - every call is recorded
+#	define TRACED_BENCHMARK(Func_) BENCHMARK(Func_)->Arg(0)->Arg(64)->Arg(1)
+#else
+#	define TRACED_BENCHMARK(Func_) BENCHMARK(Func_)
+#endif
+
+namespace
+{
+	struct noop_handler : public rethread::cancellation_handler
+	{
+		void cancel() override { }
+	};
+
+	void set_sampling(benchmark::State& state)
+	{
+#if defined(RETHREAD_TRACING)
+		rethread::trace::set_sample_rate(static_cast<unsigned>(state.range_x()));
+		rethread::trace::reset();
+#else
+		(void)state;
+#endif
+	}
+
+	/// @brief Keeps the ring buffer from overflowing, outside of the timed region
+	void drain_trace(benchmark::State& state, size_t iteration)
+	{
+#if defined(RETHREAD_TRACING)
+		if (iteration % 1024 != 0)
+			return;
+		state.PauseTiming();
+		rethread::trace::collect();
+		state.ResumeTiming();
+#else
+		(void)state;
+		(void)iteration;
+#endif
+	}
+
+	void report_trace(benchmark::State& state, rethread::trace::event e)
+	{
+#if defined(RETHREAD_TRACING)
+		rethread::trace::metrics m = rethread::trace::collect();
+		state.SetLabel(std::to_string(m[e].count) + " recorded, " + std::to_string(m.dropped) + " dropped");
+		rethread::trace::set_sample_rate(1);
+		rethread::trace::reset();
+#else
+		(void)e;
+		state.SetLabel("compiled out");
+#endif
+	}
+}
+
+
+static void traced_cv_wait_plain(benchmark::State& state)
+{
+	cv_mock cv;
+	mutex_mock m;
+	std::unique_lock<mutex_mock> l(m);
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+		rethread::wait(cv, l, token);
+}
+BENCHMARK(traced_cv_wait_plain);
+
+
+static void traced_cv_wait(benchmark::State& state)
+{
+	set_sampling(state);
+	cv_mock cv;
+	mutex_mock m;
+	std::unique_lock<mutex_mock> l(m);
+	rethread::standalone_cancellation_token token;
+	size_t i = 0;
+	while (state.KeepRunning())
+	{
+		rethread::traced::wait(cv, l, token);
+		drain_trace(state, ++i);
+	}
+	report_trace(state, rethread::trace::event::wait);
+}
+TRACED_BENCHMARK(traced_cv_wait);
+
+
+static void traced_guard_plain(benchmark::State& state)
+{
+	noop_handler h;
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+	{
+		rethread::cancellation_guard g(token, h);
+		benchmark::DoNotOptimize(&g);
+	}
+}
+BENCHMARK(traced_guard_plain);
+
+
+static void traced_guard(benchmark::State& state)
+{
+	set_sampling(state);
+	noop_handler h;
+	rethread::standalone_cancellation_token token;
+	size_t i = 0;
+	while (state.KeepRunning())
+	{
+		{
+			rethread::traced::cancellation_guard g(token, h);
+			benchmark::DoNotOptimize(&g);
+		}
+		drain_trace(state, ++i);
+	}
+	report_trace(state, rethread::trace::event::guard);
+}
+TRACED_BENCHMARK(traced_guard);
+
+
+static void traced_cancel_plain(benchmark::State& state)
+{
+	rethread::standalone_cancellation_token token;
+	while (state.KeepRunning())
+	{
+		token.cancel();
+		token.reset();
+	}
+}
+BENCHMARK(traced_cancel_plain);
+
+
+static void traced_cancel(benchmark::State& state)
+{
+	set_sampling(state);
+	rethread::standalone_cancellation_token token;
+	size_t i = 0;
+	while (state.KeepRunning())
+	{
+		rethread::traced::cancel(token);
+		token.reset();
+		drain_trace(state, ++i);
+	}
+	report_trace(state, rethread::trace::event::token_cancel);
+}
+TRACED_BENCHMARK(traced_cancel);
@@ -0,0 +1,119 @@
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <benchmark/benchmark.h>
+
+#include <rethread_ext/watched_value.hpp>
+
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+
+// Thread 0 keeps publishing new values, the other threads read them. Items are reads. Arg is the size of the value in ints
+
+namespace
+{
+	using config = std::vector<int>;
+
+	int use(const config& c)
+	{ return std::accumulate(c.begin(), c.begin() + 4, 0); }
+
+	template <typename Pointer_>
+	int use(const Pointer_& p)
+	{ return use(*p); }
+
+
+	class mutex_copy_value
+	{
+		std::mutex _mutex;
+		config     _value;
+
+	public:
+		explicit mutex_copy_value(const config& value) : _value(value) { }
+
+		void publish(const config& value)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_value = value;
+		}
+
+		config read()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			return _value;
+		}
+	};
+
+
+	class mutex_shared_ptr_value
+	{
+		std::mutex                    _mutex;
+		std::shared_ptr<const config> _value;
+
+	public:
+		explicit mutex_shared_ptr_value(const config& value) : _value(std::make_shared<config>(value)) { }
+
+		void publish(const config& value)
+		{
+			std::shared_ptr<const config> v = std::make_shared<config>(value);
+			std::unique_lock<std::mutex> l(_mutex);
+			_value.swap(v);
+		}
+
+		std::shared_ptr<const config> read()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			return _value;
+		}
+	};
+
+
+	template <typename Value_>
+	void run_reads(benchmark::State& state, Value_& value)
+	{
+		const config next(static_cast<size_t>(state.range_x()), 1);
+		int sum = 0;
+		while (state.KeepRunning())
+		{
+			if (state.thread_index == 0)
+				value.publish(next);
+			else
+				sum += use(value.read());
+		}
+		benchmark::DoNotOptimize(sum);
+		if (state.thread_index != 0)
+			state.SetItemsProcessed(state.iterations());
+	}
+}
+
+
+static void watched_value_read(benchmark::State& state)
+{
+	static rethread::watched_value<config> value(config(1024, 0));
+	run_reads(state, value);
+}
+BENCHMARK(watched_value_read)->Arg(16)->Arg(1024)->ThreadRange(2, 16)->UseRealTime();
+
+
+static void mutex_copy_read(benchmark::State& state)
+{
+	static mutex_copy_value value(config(1024, 0));
+	run_reads(state, value);
+}
+BENCHMARK(mutex_copy_read)->Arg(16)->Arg(1024)->ThreadRange(2, 16)->UseRealTime();
+
+
+static void mutex_shared_ptr_read(benchmark::State& state)
+{
+	static mutex_shared_ptr_value value(config(1024, 0));
+	run_reads(state, value);
+}
+BENCHMARK(mutex_shared_ptr_read)->Arg(16)->Arg(1024)->ThreadRange(2, 16)->UseRealTime();
@@ -0,0 +1,208 @@
+#ifndef RETHREAD_EXT_BATCH_COLLECTOR_HPP
+#define RETHREAD_EXT_BATCH_COLLECTOR_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+#include <rethread_ext/timed_wait.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace rethread
+{
+
+	/// @brief Gathers items from many producers into batches for a single consumer
+	/// @details Items are appended into one of two preallocated buffers: a producer reserves a slot with one atomic increment and
+	/// constructs the item in place, without locking. collect() swaps the buffers and hands the filled one to the consumer as a batch,
+	/// which stays valid until the next collect(), so no memory is allocated per batch.
+	/// The consumer is woken up by the producer that completes the batch, the mutex is taken only for that and while the buffer is full
+	template <typename T>
+	class batch_collector
+	{
+		static_assert(std::is_nothrow_move_constructible<T>::value, "A reserved slot must always be filled, or collect() would wait for it forever!");
+
+		using storage_type = typename std::aligned_storage<sizeof(T), RETHREAD_ALIGNOF(T)>::type;
+
+		static RETHREAD_CONSTEXPR std::uint64_t CountMask = 0xFFFFFFFF;
+
+		struct buffer
+		{
+			std::unique_ptr<storage_type[]> items;
+			std::atomic<size_t>             committed{0};
+			size_t                          size{0}; ///< items of the batch handed to the consumer
+
+			T* data() const
+			{ return reinterpret_cast<T*>(items.get()); }
+		};
+
+	public:
+		/// @brief Contiguous items of one collect() call, valid until the next one
+		class batch
+		{
+			friend class batch_collector;
+
+			T*     _items;
+			size_t _size;
+
+			batch(T* items, size_t size) :
+				_items(items), _size(size)
+			{ }
+
+		public:
+			batch() :
+				_items(nullptr), _size(0)
+			{ }
+
+			T* data() const      { return _items; }
+			size_t size() const  { return _size; }
+			bool empty() const   { return _size == 0; }
+
+			T* begin() const     { return _items; }
+			T* end() const       { return _items + _size; }
+
+			T& operator [](size_t i) const
+			{ return _items[i]; }
+		};
+
+	private:
+		size_t                     _capacity;
+		buffer                     _buffers[2];
+		size_t                     _current{0};
+		std::atomic<std::uint64_t> _state{0};            ///< index of the buffer being filled in bit 32, reserved slots in the lower half
+		std::atomic<size_t>        _threshold{0};        ///< committed count that wakes the consumer up, 0 if it does not wait
+		std::atomic<size_t>        _blockedProducers{0};
+		std::mutex                 _mutex;
+		std::condition_variable    _batchReady;
+		std::condition_variable    _notFull;
+
+	public:
+		/// @param capacity Maximum size of a batch, appending to a full collector blocks until the next collect()
+		explicit batch_collector(size_t capacity) :
+			_capacity(capacity)
+		{
+			RETHREAD_ASSERT(capacity != 0 && capacity < CountMask / 2, "Invalid capacity!");
+			_buffers[0].items.reset(new storage_type[capacity]);
+			_buffers[1].items.reset(new storage_type[capacity]);
+		}
+
+		batch_collector(const batch_collector&) = delete;
+		batch_collector& operator =(const batch_collector&) = delete;
+
+		/// @details There must be no producers left
+		~batch_collector()
+		{
+			destroy_items(_buffers[_current], _buffers[_current].committed.load(std::memory_order_acquire));
+			destroy_items(_buffers[_current ^ 1], _buffers[_current ^ 1].size);
+		}
+
+		size_t capacity() const
+		{ return _capacity; }
+
+		/// @returns false if the collector is full, the item is left untouched then
+		bool try_append(T&& item)
+		{
+			std::uint64_t state = _state.load(std::memory_order_relaxed);
+			if ((state & CountMask) >= _capacity)
+				return false;
+
+			state = _state.fetch_add(1, std::memory_order_seq_cst);
+			size_t index = static_cast<size_t>(state & CountMask);
+			if (index >= _capacity)
+				return false;
+
+			buffer& b = _buffers[(state >> 32) & 1];
+			new(b.items.get() + index) T(std::move(item));
+			if (b.committed.fetch_add(1, std::memory_order_seq_cst) + 1 == _threshold.load(std::memory_order_seq_cst))
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				_batchReady.notify_all();
+			}
+			return true;
+		}
+
+		/// @brief Waits for space if the collector is full
+		/// @returns false if the token was cancelled before the item was appended
+		bool append(T item, const cancellation_token& token)
+		{
+			while (!try_append(std::move(item)))
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				_blockedProducers.fetch_add(1, std::memory_order_seq_cst);
+				// Rechecked after announcing the producer: collect() either sees the counter or has swapped the buffers already
+				bool has_space = rethread::wait(_notFull, l, token, [this] { return (_state.load(std::memory_order_seq_cst) & CountMask) < _capacity; });
+				_blockedProducers.fetch_sub(1, std::memory_order_relaxed);
+				if (!has_space)
+					return false;
+			}
+			return true;
+		}
+
+		/// @brief Waits until max_items items are appended, max_delay passes or the token is cancelled, and takes everything appended so far
+		/// @details Must not be called concurrently. Destroys the items of the previous batch.
+		/// The batch may hold more than max_items items if the producers were faster than the consumer, but never more than capacity()
+		/// @returns Possibly empty batch, also on cancellation, so that the pending items can be flushed
+		template <typename Rep_, typename Period_>
+		batch collect(size_t max_items, const std::chrono::duration<Rep_, Period_>& max_delay, const cancellation_token& token)
+		{
+			RETHREAD_ASSERT(max_items != 0 && max_items <= _capacity, "Invalid batch size!");
+
+			buffer& previous = _buffers[_current ^ 1];
+			destroy_items(previous, previous.size);
+			previous.size = 0;
+			previous.committed.store(0, std::memory_order_relaxed);
+
+			buffer& current = _buffers[_current];
+			if (current.committed.load(std::memory_order_acquire) < max_items)
+			{
+				_threshold.store(max_items, std::memory_order_seq_cst);
+				{
+					std::unique_lock<std::mutex> l(_mutex);
+					rethread::wait_for(_batchReady, l, max_delay, token, [&] { return current.committed.load(std::memory_order_seq_cst) >= max_items; });
+				}
+				_threshold.store(0, std::memory_order_relaxed);
+			}
+
+			std::uint64_t state = _state.exchange(static_cast<std::uint64_t>(_current ^ 1) << 32, std::memory_order_seq_cst);
+			if (_blockedProducers.load(std::memory_order_seq_cst) != 0)
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				_notFull.notify_all();
+			}
+
+			// Producers that have reserved a slot are already constructing the item
+			size_t size = std::min(static_cast<size_t>(state & CountMask), _capacity);
+			while (current.committed.load(std::memory_order_acquire) != size)
+				std::this_thread::yield();
+
+			current.size = size;
+			_current ^= 1;
+			return batch(current.data(), size);
+		}
+
+	private:
+		static void destroy_items(buffer& b, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+				b.data()[i].~T();
+		}
+	};
+
+}
+
+#endif
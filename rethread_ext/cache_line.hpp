@@ -0,0 +1,41 @@
+#ifndef RETHREAD_EXT_CACHE_LINE_HPP
+#define RETHREAD_EXT_CACHE_LINE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <utility>
+
+#if !defined(RETHREAD_CACHE_LINE_SIZE)
+#	define RETHREAD_CACHE_LINE_SIZE 64
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#	define RETHREAD_CACHE_ALIGNED __declspec(align(RETHREAD_CACHE_LINE_SIZE))
+#else
+#	define RETHREAD_CACHE_ALIGNED alignas(RETHREAD_CACHE_LINE_SIZE)
+#endif
+
+namespace rethread
+{
+
+	/// @brief Gives T a cache line of its own, so that neighbouring objects in an array don't share it
+	/// @details Alignment is only guaranteed for static and automatic storage: C++11 operator new ignores extended alignment
+	template <typename T>
+	struct RETHREAD_CACHE_ALIGNED cache_line_padded : public T
+	{
+		template <typename... Args_>
+		cache_line_padded(Args_&&... args) :
+			T(std::forward<Args_>(args)...)
+		{ }
+	};
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef RETHREAD_EXT_CANCELLATION_DISPATCHER_HPP
+#define RETHREAD_EXT_CANCELLATION_DISPATCHER_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+#include <rethread/thread.hpp>
+
+#include <rethread_ext/compact_cancellation_token.hpp>
+#include <rethread_ext/trace.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace rethread
+{
+
+	/// @brief Runs cancellation jobs on its own thread, so that the thread calling cancel() doesn't run cancellation handlers
+	class cancellation_dispatcher
+	{
+	public:
+		/// @brief Intrusive queue node. Posting a job never allocates
+		class job
+		{
+			friend class cancellation_dispatcher;
+
+			job* _next{nullptr};
+			bool _queued{false};
+
+		public:
+			virtual void run() = 0;
+
+		protected:
+			job() { }
+			job(const job&) = delete;
+			job& operator =(const job&) = delete;
+			~job() { }
+		};
+
+	private:
+		std::mutex              _mutex;
+		std::condition_variable _cv;
+		std::condition_variable _doneCv;
+		job*                    _head{nullptr};
+		job*                    _tail{nullptr};
+		job*                    _running{nullptr};
+		rethread::thread        _thread;
+
+	public:
+		cancellation_dispatcher() :
+			_thread([this] (const cancellation_token& t) { thread_func(t); })
+		{ }
+
+		cancellation_dispatcher(const cancellation_dispatcher&) = delete;
+		cancellation_dispatcher& operator =(const cancellation_dispatcher&) = delete;
+
+		/// @brief Jobs that were posted before destruction are still run
+		~cancellation_dispatcher()
+		{ _thread.reset(); }
+
+		void post(job& j)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			RETHREAD_ASSERT(!j._queued, "Job is already queued!");
+			j._queued = true;
+			j._next = nullptr;
+			if (_tail)
+				_tail->_next = &j;
+			else
+				_head = &j;
+			_tail = &j;
+			_cv.notify_one();
+		}
+
+		/// @brief Blocks until the job is neither queued nor running
+		void wait(job& j)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			while (j._queued || _running == &j)
+				_doneCv.wait(l);
+		}
+
+	private:
+		void thread_func(const cancellation_token& t)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			while (true)
+			{
+				while (!_head)
+				{
+					if (!t)
+						return;
+					rethread::wait(_cv, l, t);
+				}
+
+				job* j = _head;
+				_head = j->_next;
+				if (!_head)
+					_tail = nullptr;
+				j->_queued = false;
+				_running = j;
+
+				l.unlock();
+				j->run();
+				l.lock();
+
+				_running = nullptr;
+				_doneCv.notify_all();
+			}
+		}
+	};
+
+
+	/// @brief Splits cancellation of a target into the part that async_canceller::cancel() does in place and the part deferred to the dispatcher
+	/// @details The cancel() of the rethread tokens and sources can't be split, so by default all of it is deferred
+	template <typename Cancellable_>
+	struct async_cancel_traits
+	{
+		/// @returns Whether the rest of the cancellation has to be run by the dispatcher
+		static bool begin_cancel(Cancellable_&)
+		{ return true; }
+
+		static void finish_cancel(Cancellable_& target)
+		{ target.cancel(); }
+	};
+
+
+	/// @brief compact_cancellation_token is cancelled in place, only its handler is called by the dispatcher
+	template <>
+	struct async_cancel_traits<compact_cancellation_token>
+	{
+		static bool begin_cancel(compact_cancellation_token& target)
+		{ return target.begin_cancel(); }
+
+		static void finish_cancel(compact_cancellation_token& target)
+		{ target.finish_cancel(); }
+	};
+
+
+	// async_canceller keeps a trace::stopwatch, so its layout depends on RETHREAD_TRACING
+	inline namespace RETHREAD_TRACE_ABI_NAMESPACE
+	{
+
+		/// @brief Opt-in asynchronous cancellation of a cancellation_token_source, a standalone_cancellation_token or a compact_cancellation_token
+		/// @details cancel() queues the handlers of the target to the dispatcher, so its cost doesn't depend on their number.
+		/// A compact_cancellation_token is cancelled before cancel() returns. Tokens of the other targets observe the cancellation once the dispatcher gets to the job,
+		/// because their cancel() sets the flag and calls the handlers in one go
+		template <typename Cancellable_>
+		class async_canceller : private cancellation_dispatcher::job
+		{
+			using traits = async_cancel_traits<Cancellable_>;
+
+			Cancellable_&            _target;
+			cancellation_dispatcher& _dispatcher;
+			std::atomic<bool>        _requested{false};
+			trace::stopwatch         _latency;
+
+		public:
+			async_canceller(Cancellable_& target, cancellation_dispatcher& dispatcher) :
+				_target(target), _dispatcher(dispatcher)
+			{ }
+
+			async_canceller(const async_canceller&) = delete;
+			async_canceller& operator =(const async_canceller&) = delete;
+
+			~async_canceller()
+			{ wait(); }
+
+			void cancel()
+			{
+				if (_requested.exchange(true, std::memory_order_acq_rel))
+					return;
+				if (!traits::begin_cancel(_target))
+					return;
+				_latency.start();
+				_dispatcher.post(*this);
+			}
+
+			bool is_cancel_requested() const
+			{ return _requested.load(std::memory_order_acquire); }
+
+			/// @brief Blocks until the target's handlers have returned
+			void wait()
+			{ _dispatcher.wait(*this); }
+
+			/// @brief Waits for the pending cancellation, so that cancel() may be requested again. The target itself has to be reset separately
+			void reset()
+			{
+				wait();
+				_requested.store(false, std::memory_order_release);
+			}
+
+		private:
+			void run() override
+			{
+				traits::finish_cancel(_target);
+				_latency.stop(trace::event::async_cancel);
+			}
+		};
+
+	}
+
+}
+
+#endif
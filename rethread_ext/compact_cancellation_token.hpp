@@ -0,0 +1,170 @@
+#ifndef RETHREAD_EXT_COMPACT_CANCELLATION_TOKEN_HPP
+#define RETHREAD_EXT_COMPACT_CANCELLATION_TOKEN_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+
+#include <rethread_ext/cache_line.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace rethread
+{
+
+	template <typename Cancellable_>
+	struct async_cancel_traits;
+
+
+	/// @brief Drop-in replacement for standalone_cancellation_token without mutex and condition variable
+	/// @details State flags and registered handler pointer are packed into a single atomic word.
+	/// The cancelled flag of the base class duplicates CancelledFlag, because is_cancelled() of the submodule is not virtual and reads it,
+	/// so the token takes the vtable pointer, that flag and the word, i.e. 24 bytes on 64-bit platforms.
+	/// Unregistration that races with cancel() yields until the handler returns, sleep_for() creates its condition variable on the stack
+	class compact_cancellation_token : public cancellation_token
+	{
+		friend struct async_cancel_traits<compact_cancellation_token>;
+
+		static RETHREAD_CONSTEXPR std::uintptr_t CancelledFlag  = 1;
+		static RETHREAD_CONSTEXPR std::uintptr_t CancelDoneFlag = 2;
+		static RETHREAD_CONSTEXPR std::uintptr_t FlagsMask      = CancelledFlag | CancelDoneFlag;
+
+		mutable std::atomic<std::uintptr_t> _state{0};
+
+	public:
+		compact_cancellation_token() { }
+		compact_cancellation_token(const compact_cancellation_token&) = delete;
+		compact_cancellation_token& operator =(const compact_cancellation_token&) = delete;
+
+		~compact_cancellation_token()
+		{ RETHREAD_ASSERT((_state.load(std::memory_order_relaxed) & ~FlagsMask) == 0, "Cancellation handler is still registered!"); }
+
+		void cancel()
+		{
+			if (begin_cancel())
+				finish_cancel();
+		}
+
+		void reset()
+		{
+			RETHREAD_ASSERT((_state.load(std::memory_order_relaxed) & ~FlagsMask) == 0, "Cancellation handler is still registered!");
+			_state.store(0, std::memory_order_relaxed);
+			_cancelled.store(false, std::memory_order_release);
+		}
+
+	protected:
+		void do_sleep_for(const std::chrono::nanoseconds& duration) const override
+		{
+			struct sleep_handler : public cancellation_handler
+			{
+				std::mutex              _mutex;
+				std::condition_variable _cv;
+				bool                    _cancelled{false};
+
+				void cancel() override
+				{
+					std::unique_lock<std::mutex> l(_mutex);
+					_cancelled = true;
+					_cv.notify_all();
+				}
+			};
+
+			sleep_handler handler;
+			if (!try_register_cancellation_handler(handler))
+				return;
+
+			{
+				std::unique_lock<std::mutex> l(handler._mutex);
+				auto end_time = std::chrono::steady_clock::now() + duration;
+				while (!handler._cancelled && handler._cv.wait_until(l, end_time) != std::cv_status::timeout)
+					;
+			}
+
+			if (!try_unregister_cancellation_handler(handler))
+				unregister_cancellation_handler(handler);
+		}
+
+		bool try_register_cancellation_handler(cancellation_handler& handler) const override
+		{
+			std::uintptr_t expected = 0;
+			if (_state.compare_exchange_strong(expected, to_state(handler), std::memory_order_acq_rel, std::memory_order_acquire))
+				return true;
+
+			RETHREAD_ASSERT((expected & ~FlagsMask) == 0, "Cancellation handler is already registered!");
+			return false;
+		}
+
+		bool try_unregister_cancellation_handler(cancellation_handler& handler) const override
+		{
+			std::uintptr_t expected = to_state(handler);
+			return _state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_acquire);
+		}
+
+		void unregister_cancellation_handler(cancellation_handler& handler) const override
+		{
+			while ((_state.load(std::memory_order_acquire) & CancelDoneFlag) == 0)
+				std::this_thread::yield();
+
+			_state.fetch_and(FlagsMask, std::memory_order_release);
+			handler.reset();
+		}
+
+	private:
+		/// @brief Makes the token cancelled, new handlers fail to register from now on
+		/// @returns Whether this call has cancelled the token, finish_cancel() has to follow then
+		bool begin_cancel()
+		{
+			std::uintptr_t state = _state.load(std::memory_order_relaxed);
+			do
+			{
+				if (state & CancelledFlag)
+					return false;
+			} while (!_state.compare_exchange_weak(state, state | CancelledFlag, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+			_cancelled.store(true, std::memory_order_release);
+			return true;
+		}
+
+		/// @brief Calls the handler that was registered at begin_cancel(), it can't be unregistered in between
+		void finish_cancel()
+		{
+			cancellation_handler* handler = to_handler(_state.load(std::memory_order_acquire));
+			if (handler)
+				handler->cancel();
+
+			_state.fetch_or(CancelDoneFlag, std::memory_order_release);
+		}
+
+		static std::uintptr_t to_state(cancellation_handler& handler)
+		{
+			std::uintptr_t result = reinterpret_cast<std::uintptr_t>(&handler);
+			RETHREAD_ASSERT((result & FlagsMask) == 0, "Cancellation handler is misaligned!");
+			return result;
+		}
+
+		static cancellation_handler* to_handler(std::uintptr_t state)
+		{ return reinterpret_cast<cancellation_handler*>(state & ~FlagsMask); }
+	};
+
+
+	static_assert(sizeof(compact_cancellation_token) <= sizeof(cancellation_token) + sizeof(std::uintptr_t), "The state word must be the only member!");
+
+
+	using padded_standalone_cancellation_token = cache_line_padded<standalone_cancellation_token>;
+	using padded_compact_cancellation_token    = cache_line_padded<compact_cancellation_token>;
+
+}
+
+#endif
@@ -0,0 +1,540 @@
+#ifndef RETHREAD_EXT_COROUTINE_HPP
+#define RETHREAD_EXT_COROUTINE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// C++20 awaitables for cancellation tokens, poll and sleep_for. Requires RETHREAD_HAS_COROUTINES (scons COROUTINES=1) and RETHREAD_HAS_POLL.
+// A suspended coroutine doesn't occupy a thread: cancellation handlers and the reactor only post its handle to the coroutine_scheduler.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace rethread
+{
+
+	class coroutine_scheduler;
+
+	namespace detail
+	{
+		/// @brief Base of the awaiters. Whoever completes it first (cancellation handler or reactor) posts the coroutine
+		class pending_operation : public cancellation_handler
+		{
+			enum state { arming, armed, completed };
+
+			std::atomic<int>                  _state{arming};
+
+		protected:
+			coroutine_scheduler*              _scheduler{nullptr};
+			std::coroutine_handle<>           _handle;
+			std::optional<cancellation_guard> _guard;
+
+		public:
+			void cancel() override;
+
+			/// @returns Whether the caller has to post the coroutine
+			bool try_complete()
+			{ return _state.exchange(completed, std::memory_order_acq_rel) == armed; }
+
+			std::coroutine_handle<> handle() const
+			{ return _handle; }
+
+		protected:
+			void start_arming(std::coroutine_handle<> handle);
+
+			void register_handler(const cancellation_token& token)
+			{
+				_guard.emplace(token, *this);
+				if (_guard->is_cancelled())
+					try_complete();
+			}
+
+			/// @brief Must be the last thing await_suspend does: once armed, the coroutine may be resumed on another thread
+			/// @returns Whether the coroutine stays suspended
+			bool finish_arming()
+			{
+				int expected = arming;
+				return _state.compare_exchange_strong(expected, armed, std::memory_order_acq_rel);
+			}
+
+			void unregister_handler()
+			{ _guard.reset(); }
+		};
+
+
+		struct io_operation : public pending_operation
+		{
+			int           _fd{-1};
+			short         _events{0};
+			short         _revents{0};
+			std::uint64_t _id{0};
+		};
+
+
+		struct timer_operation : public pending_operation
+		{
+			std::chrono::steady_clock::time_point _deadline;
+			bool                                  _queued{false};
+		};
+	}
+
+
+	/// @brief Runs coroutines and waits for their descriptors and timers
+	/// @details Single-threaded when run() is called from one thread, multi-threaded when from several (see coroutine_thread_pool).
+	/// Threads in run() take turns polling, the rest wait for ready coroutines
+	class coroutine_scheduler
+	{
+		friend class poll_awaiter;
+		template <typename Rep_, typename Period_> friend class sleep_awaiter;
+
+		using timer_map = std::multimap<std::chrono::steady_clock::time_point, detail::timer_operation*>;
+		using io_map    = std::unordered_map<std::uint64_t, detail::io_operation*>;
+
+		std::mutex                          _mutex;
+		std::condition_variable             _cv;
+		std::deque<std::coroutine_handle<>> _ready;
+		io_map                              _io;
+		std::uint64_t                       _ioCounter{0};
+		timer_map                           _timers;
+		bool                                _polling{false};
+		bool                                _wakeupPending{false};
+		size_t                              _idleThreads{0};
+		int                                 _wakeup[2];
+
+	public:
+		coroutine_scheduler()
+		{
+			RETHREAD_CHECK(::pipe(_wakeup) == 0, std::system_error(errno, std::system_category()));
+			for (int fd : _wakeup)
+				::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+		}
+
+		coroutine_scheduler(const coroutine_scheduler&) = delete;
+		coroutine_scheduler& operator =(const coroutine_scheduler&) = delete;
+
+		/// @brief Coroutines that are still suspended are leaked
+		~coroutine_scheduler()
+		{
+			::close(_wakeup[0]);
+			::close(_wakeup[1]);
+		}
+
+		/// @returns Scheduler that runs the calling thread's coroutine, nullptr outside of run() and run_ready()
+		static coroutine_scheduler* current()
+		{ return current_ref(); }
+
+		void post(std::coroutine_handle<> handle)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			post_locked(handle);
+		}
+
+		/// @brief Runs coroutines and polls until the token is cancelled
+		void run(const cancellation_token& token)
+		{
+			struct stop_handler : public cancellation_handler
+			{
+				coroutine_scheduler& _scheduler;
+
+				stop_handler(coroutine_scheduler& scheduler) : _scheduler(scheduler) { }
+
+				void cancel() override
+				{
+					std::unique_lock<std::mutex> l(_scheduler._mutex);
+					_scheduler._cv.notify_all();
+					_scheduler.wake_poller_locked();
+				}
+			};
+
+			current_scope scope(*this);
+			stop_handler handler(*this);
+			cancellation_guard guard(token, handler);
+
+			std::unique_lock<std::mutex> l(_mutex);
+			while (token)
+			{
+				if (!_ready.empty())
+					resume_front(l);
+				else if (!_polling)
+					poll_locked(l, -1);
+				else
+				{
+					++_idleThreads;
+					_cv.wait(l);
+					--_idleThreads;
+				}
+			}
+		}
+
+		/// @brief Services due descriptors and timers without blocking and resumes everything that is ready
+		/// @returns Number of resumed coroutines
+		size_t run_ready()
+		{
+			current_scope scope(*this);
+			size_t result = 0;
+
+			std::unique_lock<std::mutex> l(_mutex);
+			if (!_polling && (!_io.empty() || !_timers.empty()))
+				poll_locked(l, 0);
+			for (; !_ready.empty(); ++result)
+				resume_front(l);
+			return result;
+		}
+
+	private:
+		class current_scope
+		{
+			coroutine_scheduler* _prev;
+
+		public:
+			current_scope(coroutine_scheduler& s) : _prev(current_ref()) { current_ref() = &s; }
+			~current_scope() { current_ref() = _prev; }
+		};
+
+		static coroutine_scheduler*& current_ref()
+		{
+			static thread_local coroutine_scheduler* instance = nullptr;
+			return instance;
+		}
+
+		void resume_front(std::unique_lock<std::mutex>& l)
+		{
+			std::coroutine_handle<> handle = _ready.front();
+			_ready.pop_front();
+			l.unlock();
+			handle.resume();
+			l.lock();
+		}
+
+		void post_locked(std::coroutine_handle<> handle)
+		{
+			_ready.push_back(handle);
+			if (_idleThreads != 0)
+				_cv.notify_one();
+			else
+				wake_poller_locked();
+		}
+
+		void wake_poller_locked()
+		{
+			if (!_polling || _wakeupPending)
+				return;
+			_wakeupPending = true;
+			char dummy = 0;
+			RETHREAD_CHECK(::write(_wakeup[1], &dummy, 1) == 1, std::system_error(errno, std::system_category()));
+		}
+
+		void add_io(detail::io_operation& op)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			op._id = ++_ioCounter;
+			_io.emplace(op._id, &op);
+			wake_poller_locked();
+		}
+
+		void remove_io(detail::io_operation& op)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_io.erase(op._id);
+		}
+
+		timer_map::iterator add_timer(detail::timer_operation& op)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			bool earliest = _timers.empty() || op._deadline < _timers.begin()->first;
+			op._queued = true;
+			timer_map::iterator result = _timers.emplace(op._deadline, &op);
+			if (earliest)
+				wake_poller_locked();
+			return result;
+		}
+
+		void remove_timer(detail::timer_operation& op, timer_map::iterator it)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			if (op._queued)
+				_timers.erase(it);
+		}
+
+		void complete_locked(detail::pending_operation& op)
+		{
+			if (op.try_complete())
+				post_locked(op.handle());
+		}
+
+		// Operations may complete and go away while the mutex is released, so descriptors are matched back by id
+		void poll_locked(std::unique_lock<std::mutex>& l, int timeout_ms)
+		{
+			_polling = true;
+
+			std::vector<pollfd> fds;
+			std::vector<std::uint64_t> ids;
+			fds.reserve(_io.size() + 1);
+			ids.reserve(_io.size());
+			fds.push_back(pollfd{ _wakeup[0], POLLIN, 0 });
+			for (const auto& io : _io)
+			{
+				fds.push_back(pollfd{ io.second->_fd, io.second->_events, 0 });
+				ids.push_back(io.first);
+			}
+
+			if (timeout_ms != 0 && !_timers.empty())
+			{
+				auto left = std::chrono::ceil<std::chrono::milliseconds>(_timers.begin()->first - std::chrono::steady_clock::now()).count();
+				timeout_ms = static_cast<int>(std::clamp<decltype(left)>(left, 0, INT_MAX));
+			}
+
+			l.unlock();
+			int result = ::poll(fds.data(), fds.size(), timeout_ms);
+			int error = errno;
+			l.lock();
+
+			_polling = false;
+			RETHREAD_CHECK(result != -1 || error == EINTR, std::system_error(error, std::system_category()));
+
+			if (fds[0].revents != 0)
+			{
+				char buf[16];
+				while (::read(_wakeup[0], buf, sizeof(buf)) > 0)
+					;
+				_wakeupPending = false;
+			}
+
+			for (size_t i = 0; result > 0 && i < ids.size(); ++i)
+			{
+				if (fds[i + 1].revents == 0)
+					continue;
+				io_map::iterator it = _io.find(ids[i]);
+				if (it == _io.end())
+					continue;
+				detail::io_operation* op = it->second;
+				op->_revents = fds[i + 1].revents;
+				_io.erase(it);
+				complete_locked(*op);
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			while (!_timers.empty() && _timers.begin()->first <= now)
+			{
+				detail::timer_operation* op = _timers.begin()->second;
+				op->_queued = false;
+				_timers.erase(_timers.begin());
+				complete_locked(*op);
+			}
+
+			if (!_ready.empty() && _idleThreads != 0)
+				_cv.notify_all(); // somebody has to take over polling while this thread resumes coroutines
+		}
+	};
+
+
+	namespace detail
+	{
+		inline void pending_operation::cancel()
+		{
+			if (try_complete())
+				_scheduler->post(_handle);
+		}
+
+		inline void pending_operation::start_arming(std::coroutine_handle<> handle)
+		{
+			_scheduler = coroutine_scheduler::current();
+			RETHREAD_ASSERT(_scheduler, "Awaiting outside of coroutine_scheduler!");
+			_handle = handle;
+		}
+	}
+
+
+	class cancelled_awaiter : public detail::pending_operation
+	{
+		const cancellation_token& _token;
+
+	public:
+		explicit cancelled_awaiter(const cancellation_token& token) :
+			_token(token)
+		{ }
+
+		bool await_ready() const
+		{ return _token.is_cancelled(); }
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			start_arming(handle);
+			register_handler(_token);
+			return finish_arming();
+		}
+
+		void await_resume()
+		{ unregister_handler(); }
+	};
+
+
+	class poll_awaiter : public detail::io_operation
+	{
+		const cancellation_token& _token;
+
+	public:
+		poll_awaiter(int fd, short events, const cancellation_token& token) :
+			_token(token)
+		{
+			_fd = fd;
+			_events = events;
+		}
+
+		bool await_ready() const
+		{ return _token.is_cancelled(); }
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			start_arming(handle);
+			_scheduler->add_io(*this);
+			register_handler(_token);
+			return finish_arming();
+		}
+
+		/// @returns Same as rethread::poll, 0 if cancelled
+		short await_resume()
+		{
+			if (_scheduler)
+				_scheduler->remove_io(*this);
+			unregister_handler();
+			return _revents;
+		}
+	};
+
+
+	template <typename Rep_, typename Period_>
+	class sleep_awaiter : public detail::timer_operation
+	{
+		const cancellation_token&                   _token;
+		std::chrono::duration<Rep_, Period_>        _duration;
+		coroutine_scheduler::timer_map::iterator    _it;
+
+	public:
+		sleep_awaiter(const std::chrono::duration<Rep_, Period_>& duration, const cancellation_token& token) :
+			_token(token), _duration(duration)
+		{ }
+
+		bool await_ready() const
+		{ return _token.is_cancelled() || _duration <= _duration.zero(); }
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			start_arming(handle);
+			_deadline = std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(_duration);
+			_it = _scheduler->add_timer(*this);
+			register_handler(_token);
+			return finish_arming();
+		}
+
+		void await_resume()
+		{
+			if (_scheduler)
+				_scheduler->remove_timer(*this, _it);
+			unregister_handler();
+		}
+	};
+
+
+	inline cancelled_awaiter cancelled(const cancellation_token& token)
+	{ return cancelled_awaiter(token); }
+
+
+	inline poll_awaiter async_poll(int fd, short events, const cancellation_token& token)
+	{ return poll_awaiter(fd, events, token); }
+
+
+	template <typename Rep_, typename Period_>
+	sleep_awaiter<Rep_, Period_> async_sleep_for(const std::chrono::duration<Rep_, Period_>& duration, const cancellation_token& token)
+	{ return sleep_awaiter<Rep_, Period_>(duration, token); }
+
+
+	/// @brief Coroutine that starts when posted to a coroutine_scheduler and destroys itself when finished
+	/// @details Arguments are copied into the frame, lambda captures are not: pass state as parameters
+	class detached_task
+	{
+	public:
+		struct promise_type
+		{
+			detached_task get_return_object() { return detached_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() { }
+			void unhandled_exception() { std::terminate(); }
+		};
+
+	private:
+		std::coroutine_handle<promise_type> _handle;
+
+		explicit detached_task(std::coroutine_handle<promise_type> handle) : _handle(handle) { }
+
+	public:
+		detached_task(detached_task&& other) noexcept : _handle(other._handle) { other._handle = nullptr; }
+		detached_task(const detached_task&) = delete;
+		detached_task& operator =(const detached_task&) = delete;
+
+		~detached_task()
+		{
+			if (_handle)
+				_handle.destroy();
+		}
+
+		std::coroutine_handle<> release()
+		{
+			std::coroutine_handle<> result = _handle;
+			_handle = nullptr;
+			return result;
+		}
+	};
+
+
+	inline void spawn(coroutine_scheduler& scheduler, detached_task task)
+	{ scheduler.post(task.release()); }
+
+
+	/// @brief Multi-threaded scheduler: runs the scheduler on the given number of threads until destroyed
+	class coroutine_thread_pool
+	{
+		std::vector<std::unique_ptr<rethread::thread>> _threads;
+
+	public:
+		coroutine_thread_pool(coroutine_scheduler& scheduler, size_t threads_count)
+		{
+			for (size_t i = 0; i < threads_count; ++i)
+				_threads.emplace_back(new rethread::thread([&scheduler] (const cancellation_token& t) { scheduler.run(t); }));
+		}
+
+		coroutine_thread_pool(const coroutine_thread_pool&) = delete;
+		coroutine_thread_pool& operator =(const coroutine_thread_pool&) = delete;
+	};
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef RETHREAD_EXT_IO_HPP
+#define RETHREAD_EXT_IO_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/poll.hpp>
+
+#include <cerrno>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Cancellable counterparts of the blocking syscalls for non-blocking descriptors.
+// The syscall is tried first, readiness is only waited for (with rethread::poll) on EAGAIN.
+// Return values and errno follow the syscalls, cancellation is reported as -1 with errno set to ECANCELED.
+// A descriptor that became ready is still serviced when the token is cancelled at the same time.
+
+namespace rethread
+{
+
+	namespace detail
+	{
+		/// @brief Closes the descriptor preserving errno
+		class fd_holder
+		{
+			int _fd;
+
+		public:
+			explicit fd_holder(int fd) : _fd(fd) { }
+
+			fd_holder(const fd_holder&) = delete;
+			fd_holder& operator =(const fd_holder&) = delete;
+
+			~fd_holder()
+			{
+				if (_fd == -1)
+					return;
+				int saved_errno = errno;
+				::close(_fd);
+				errno = saved_errno;
+			}
+
+			int get() const { return _fd; }
+		};
+
+
+		template <typename Result_, typename Syscall_>
+		Result_ cancellable_io(int fd, short events, const cancellation_token& token, const Syscall_& syscall)
+		{
+			while (true)
+			{
+				Result_ result = syscall();
+				if (result >= 0)
+					return result;
+
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					return result;
+
+				if (rethread::poll(fd, events, token) == 0 && token.is_cancelled())
+				{
+					errno = ECANCELED;
+					return -1;
+				}
+			}
+		}
+	}
+
+
+	inline ssize_t read(int fd, void* buf, size_t count, const cancellation_token& token)
+	{ return detail::cancellable_io<ssize_t>(fd, POLLIN, token, [=] { return ::read(fd, buf, count); }); }
+
+
+	inline ssize_t write(int fd, const void* buf, size_t count, const cancellation_token& token)
+	{ return detail::cancellable_io<ssize_t>(fd, POLLOUT, token, [=] { return ::write(fd, buf, count); }); }
+
+
+	inline ssize_t readv(int fd, const iovec* iov, int iovcnt, const cancellation_token& token)
+	{ return detail::cancellable_io<ssize_t>(fd, POLLIN, token, [=] { return ::readv(fd, iov, iovcnt); }); }
+
+
+	inline ssize_t writev(int fd, const iovec* iov, int iovcnt, const cancellation_token& token)
+	{ return detail::cancellable_io<ssize_t>(fd, POLLOUT, token, [=] { return ::writev(fd, iov, iovcnt); }); }
+
+
+	/// @brief Accepted descriptor is blocking, as with ::accept
+	inline int accept(int fd, sockaddr* addr, socklen_t* addrlen, const cancellation_token& token)
+	{ return detail::cancellable_io<int>(fd, POLLIN, token, [=] { return ::accept(fd, addr, addrlen); }); }
+
+
+	/// @brief On cancellation the connection attempt is left in progress, the socket should be closed
+	inline int connect(int fd, const sockaddr* addr, socklen_t addrlen, const cancellation_token& token)
+	{
+		int result = ::connect(fd, addr, addrlen);
+		while (result != 0 && errno == EINTR)
+			result = ::connect(fd, addr, addrlen);
+		if (result == 0 || errno != EINPROGRESS)
+			return result;
+
+		while (true)
+		{
+			if (rethread::poll(fd, POLLOUT, token) != 0)
+				break;
+			if (token.is_cancelled())
+			{
+				errno = ECANCELED;
+				return -1;
+			}
+		}
+
+		int error = 0;
+		socklen_t error_len = sizeof(error);
+		if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0)
+			return -1;
+		if (error != 0)
+		{
+			errno = error;
+			return -1;
+		}
+		return 0;
+	}
+
+}
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef RETHREAD_EXT_PIPELINE_HPP
+#define RETHREAD_EXT_PIPELINE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+#include <rethread/thread.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rethread
+{
+
+	/// @brief Bounded MPMC queue that moves items in batches
+	/// @details close() lets consumers take what is left and then makes pop() return false
+	template <typename T>
+	class bounded_queue
+	{
+		std::mutex              _mutex;
+		std::condition_variable _notEmpty;
+		std::condition_variable _notFull;
+		std::deque<T>           _items;
+		size_t                  _capacity;
+		bool                    _closed{false};
+
+	public:
+		explicit bounded_queue(size_t capacity) :
+			_capacity(capacity)
+		{ RETHREAD_ASSERT(capacity != 0, "Capacity must be positive!"); }
+
+		bounded_queue(const bounded_queue&) = delete;
+		bounded_queue& operator =(const bounded_queue&) = delete;
+
+		/// @brief Moves all the items into the queue, waiting for free space as needed. Clears the batch
+		/// @returns false if the queue was closed or the token was cancelled before everything was pushed, the rest is dropped
+		bool push(std::vector<T>& batch, const cancellation_token& token)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			size_t i = 0;
+			while (i < batch.size() && !_closed)
+			{
+				if (_items.size() >= _capacity)
+				{
+					if (!rethread::wait(_notFull, l, token, [this] { return _closed || _items.size() < _capacity; }))
+						break;
+					continue;
+				}
+
+				bool was_empty = _items.empty();
+				for (; i < batch.size() && _items.size() < _capacity; ++i)
+					_items.push_back(std::move(batch[i]));
+				if (was_empty)
+					_notEmpty.notify_all();
+			}
+
+			bool result = i == batch.size();
+			batch.clear();
+			return result;
+		}
+
+		bool push(T item, const cancellation_token& token)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			if (_items.size() >= _capacity && !rethread::wait(_notFull, l, token, [this] { return _closed || _items.size() < _capacity; }))
+				return false;
+			if (_closed)
+				return false;
+
+			_items.push_back(std::move(item));
+			if (_items.size() == 1)
+				_notEmpty.notify_all();
+			return true;
+		}
+
+		/// @brief Waits for items and moves up to max_count of them to the end of the batch
+		/// @returns false if the queue was closed and is empty, or the token was cancelled (even if there are items left)
+		bool pop(std::vector<T>& batch, size_t max_count, const cancellation_token& token)
+		{
+			if (token.is_cancelled())
+				return false;
+
+			std::unique_lock<std::mutex> l(_mutex);
+			if (_items.empty() && !rethread::wait(_notEmpty, l, token, [this] { return _closed || !_items.empty(); }))
+				return false;
+			if (_items.empty())
+				return false;
+
+			bool was_full = _items.size() >= _capacity;
+			for (size_t i = 0; i < max_count && !_items.empty(); ++i)
+			{
+				batch.push_back(std::move(_items.front()));
+				_items.pop_front();
+			}
+			if (was_full)
+				_notFull.notify_all();
+			return true;
+		}
+
+		void close()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_closed = true;
+			_notEmpty.notify_all();
+			_notFull.notify_all();
+		}
+	};
+
+
+	enum class pipeline_cancel_policy
+	{
+		drain, ///< stop accepting input, let the stages process what is already in flight
+		drop   ///< stop all the stages at once, in-flight items are destroyed
+	};
+
+
+	struct pipeline_options
+	{
+		size_t                 queue_capacity{1024};
+		size_t                 batch_size{64};
+		pipeline_cancel_policy cancel_policy{pipeline_cancel_policy::drop};
+	};
+
+
+	namespace detail
+	{
+		struct pipeline_state
+		{
+			using stage_body = std::function<void(const cancellation_token&)>;
+
+			pipeline_options                               _options;
+			cancellation_token_source                      _source;
+			std::vector<stage_body>                        _bodies;
+			std::vector<std::unique_ptr<rethread::thread>> _threads;
+			std::mutex                                     _mutex;
+			std::condition_variable                        _cv;
+			size_t                                         _running{0};
+
+			explicit pipeline_state(const pipeline_options& options) :
+				_options(options)
+			{ }
+
+			void start()
+			{
+				_running = _bodies.size();
+				for (size_t i = 0; i < _bodies.size(); ++i)
+					_threads.emplace_back(new rethread::thread([this, i] (const cancellation_token&)
+					{
+						sourced_cancellation_token token(_source.create_token());
+						_bodies[i](token);
+
+						std::unique_lock<std::mutex> l(_mutex);
+						if (--_running == 0)
+							_cv.notify_all();
+					}));
+			}
+
+			void wait()
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				while (_running != 0)
+					_cv.wait(l);
+			}
+
+			~pipeline_state()
+			{
+				_source.cancel();
+				_threads.clear();
+			}
+		};
+
+
+		/// @brief Runs the stage on its thread, the last thread of the stage closes the output queue
+		template <typename In_, typename Out_, typename Func_>
+		void run_stage(bounded_queue<In_>& input, bounded_queue<Out_>& output, std::atomic<size_t>& active, const Func_& func, size_t batch_size, const cancellation_token& token)
+		{
+			std::vector<In_> in;
+			std::vector<Out_> out;
+			in.reserve(batch_size);
+			out.reserve(batch_size);
+			while (input.pop(in, batch_size, token))
+			{
+				for (size_t i = 0; i < in.size(); ++i)
+					out.push_back(func(std::move(in[i])));
+				in.clear();
+				if (!output.push(out, token))
+					break;
+			}
+			if (--active == 0)
+				output.close();
+		}
+
+
+		template <typename In_, typename Func_>
+		void run_sink(bounded_queue<In_>& input, const Func_& func, size_t batch_size, const cancellation_token& token)
+		{
+			std::vector<In_> in;
+			in.reserve(batch_size);
+			while (input.pop(in, batch_size, token))
+			{
+				for (size_t i = 0; i < in.size(); ++i)
+					func(std::move(in[i]));
+				in.clear();
+			}
+		}
+	}
+
+
+	/// @brief Running pipeline, created with make_pipeline()
+	/// @details All the stages wait on the tokens of one cancellation_token_source, so cancel() stops the whole chain
+	template <typename In_>
+	class pipeline
+	{
+		std::shared_ptr<detail::pipeline_state> _state;
+		std::shared_ptr<bounded_queue<In_>>     _input;
+
+	public:
+		pipeline(const std::shared_ptr<detail::pipeline_state>& state, const std::shared_ptr<bounded_queue<In_>>& input) :
+			_state(state), _input(input)
+		{ _state->start(); }
+
+		pipeline(pipeline&& other) :
+			_state(std::move(other._state)), _input(std::move(other._input))
+		{ }
+
+		pipeline(const pipeline&) = delete;
+		pipeline& operator =(const pipeline&) = delete;
+
+		/// @brief Drops in-flight items regardless of the policy and joins the stages
+		~pipeline()
+		{
+			if (!_state)
+				return;
+			_input->close();
+			_state->_source.cancel();
+			_state->_threads.clear();
+		}
+
+		/// @returns false if the pipeline was closed or cancelled, or the token was cancelled
+		bool push(In_ item, const cancellation_token& token)
+		{ return _input->push(std::move(item), token); }
+
+		/// @brief Moves the whole batch in, clears it
+		bool push(std::vector<In_>& batch, const cancellation_token& token)
+		{ return _input->push(batch, token); }
+
+		/// @brief No more input, everything that was pushed is processed
+		void close()
+		{ _input->close(); }
+
+		/// @brief Stops the pipeline according to pipeline_options::cancel_policy
+		void cancel()
+		{
+			_input->close();
+			if (_state->_options.cancel_policy == pipeline_cancel_policy::drop)
+				_state->_source.cancel();
+		}
+
+		/// @brief Waits until all the stages have finished, i.e. the pipeline was closed and drained, or cancelled
+		void wait()
+		{ _state->wait(); }
+	};
+
+
+	template <typename In_, typename Out_>
+	class pipeline_builder
+	{
+		std::shared_ptr<detail::pipeline_state> _state;
+		std::shared_ptr<bounded_queue<In_>>     _input;
+		std::shared_ptr<bounded_queue<Out_>>    _output;
+
+	public:
+		pipeline_builder(const std::shared_ptr<detail::pipeline_state>& state, const std::shared_ptr<bounded_queue<In_>>& input, const std::shared_ptr<bounded_queue<Out_>>& output) :
+			_state(state), _input(input), _output(output)
+		{ }
+
+		/// @brief Adds a stage that transforms every item with Next_ func(Out_&&) on threads_count threads
+		template <typename Next_, typename Func_>
+		pipeline_builder<In_, Next_> stage(Func_ func, size_t threads_count = 1)
+		{
+			auto next = std::make_shared<bounded_queue<Next_>>(_state->_options.queue_capacity);
+			auto active = std::make_shared<std::atomic<size_t>>(threads_count);
+			auto input = _output;
+			size_t batch_size = _state->_options.batch_size;
+			for (size_t i = 0; i < threads_count; ++i)
+				_state->_bodies.push_back([=] (const cancellation_token& token)
+				{ detail::run_stage(*input, *next, *active, func, batch_size, token); });
+			return pipeline_builder<In_, Next_>(_state, _input, next);
+		}
+
+		/// @brief Adds the last stage that consumes every item with func(Out_&&) and starts the pipeline
+		template <typename Func_>
+		pipeline<In_> sink(Func_ func, size_t threads_count = 1)
+		{
+			auto input = _output;
+			size_t batch_size = _state->_options.batch_size;
+			for (size_t i = 0; i < threads_count; ++i)
+				_state->_bodies.push_back([=] (const cancellation_token& token)
+				{ detail::run_sink(*input, func, batch_size, token); });
+			return pipeline<In_>(_state, _input);
+		}
+	};
+
+
+	template <typename In_>
+	pipeline_builder<In_, In_> make_pipeline(const pipeline_options& options = pipeline_options())
+	{
+		auto state = std::make_shared<detail::pipeline_state>(options);
+		auto input = std::make_shared<bounded_queue<In_>>(options.queue_capacity);
+		return pipeline_builder<In_, In_>(state, input, input);
+	}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef RETHREAD_EXT_PROCESS_HPP
+#define RETHREAD_EXT_PROCESS_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/thread.hpp>
+
+#include <rethread_ext/io.hpp>
+
+#include <cerrno>
+#include <chrono>
+
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Linux only: cancellable waits for child processes (pidfd) and signals (signalfd), on top of rethread::poll.
+// As in rethread_ext/io.hpp, failures are reported as -1 with errno, ECANCELED on cancellation.
+
+namespace rethread
+{
+
+	namespace detail
+	{
+		/// @brief waitpid(WNOHANG) that reports a running child as EAGAIN, for cancellable_io
+		inline int try_reap_child(pid_t pid)
+		{
+			int status = 0;
+			pid_t result = ::waitpid(pid, &status, WNOHANG);
+			if (result == 0)
+			{
+				errno = EAGAIN;
+				return -1;
+			}
+			return result == -1 ? -1 : status;
+		}
+
+
+		static RETHREAD_CONSTEXPR std::chrono::milliseconds WaitChildFallbackInterval{1};
+	}
+
+
+	/// @brief Waits for the child to terminate and reaps it
+	/// @returns The status as reported by waitpid (use WIFEXITED, WEXITSTATUS, ...), or -1 with errno. The child is left alone on cancellation
+	/// @details Without pidfd_open (Linux < 5.3) falls back to a waitpid(WNOHANG) loop with a cancellable sleep in between
+	inline int wait_child(pid_t pid, const cancellation_token& token)
+	{
+#if defined(SYS_pidfd_open)
+		detail::fd_holder pidfd(static_cast<int>(::syscall(SYS_pidfd_open, pid, 0)));
+		if (pidfd.get() != -1)
+			return detail::cancellable_io<int>(pidfd.get(), POLLIN, token, [pid] { return detail::try_reap_child(pid); });
+		if (errno != ENOSYS)
+			return -1;
+#endif
+
+		while (true)
+		{
+			int result = detail::try_reap_child(pid);
+			if (result != -1 || (errno != EAGAIN && errno != EINTR))
+				return result;
+			if (token.is_cancelled())
+			{
+				errno = ECANCELED;
+				return -1;
+			}
+			rethread::this_thread::sleep_for(detail::WaitChildFallbackInterval, token);
+		}
+	}
+
+
+	/// @brief Waits for one of the signals and consumes it
+	/// @details The signals must be blocked (pthread_sigmask) in all the threads, otherwise they are delivered the usual way
+	/// @returns The signal number, or -1 with errno
+	inline int wait_signal(const sigset_t& signals, const cancellation_token& token, signalfd_siginfo* info = nullptr)
+	{
+		detail::fd_holder sigfd(::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC));
+		if (sigfd.get() == -1)
+			return -1;
+
+		signalfd_siginfo local_info;
+		signalfd_siginfo* target = info ? info : &local_info;
+		ssize_t result = rethread::read(sigfd.get(), target, sizeof(*target), token);
+		if (result == -1)
+			return -1;
+		return static_cast<int>(target->ssi_signo);
+	}
+
+}
+
+#endif
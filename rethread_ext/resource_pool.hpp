@@ -0,0 +1,238 @@
+#ifndef RETHREAD_EXT_RESOURCE_POOL_HPP
+#define RETHREAD_EXT_RESOURCE_POOL_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rethread
+{
+
+	/// @brief Pool of at most N resources handed out in FIFO order
+	/// @details Free resources are kept in a lock-free stack, so uncontended acquire() and release() don't lock.
+	/// When the pool is exhausted, acquire() queues up and release() hands the resource directly to the oldest waiter, waking it alone.
+	/// A cancelled acquire() leaves the queue
+	template <typename T>
+	class resource_pool
+	{
+		static RETHREAD_CONSTEXPR std::uint32_t Npos = 0xFFFFFFFF;
+
+		struct waiter
+		{
+			std::condition_variable cv;
+			std::uint32_t           index{Npos};
+			waiter*                 prev{nullptr};
+			waiter*                 next{nullptr};
+		};
+
+	public:
+		class handle
+		{
+			friend class resource_pool;
+
+			resource_pool* _pool;
+			std::uint32_t  _index;
+
+			handle(resource_pool* pool, std::uint32_t index) :
+				_pool(pool), _index(index)
+			{ }
+
+		public:
+			handle() :
+				_pool(nullptr), _index(Npos)
+			{ }
+
+			handle(handle&& other) :
+				_pool(other._pool), _index(other._index)
+			{ other._pool = nullptr; }
+
+			handle& operator =(handle&& other)
+			{
+				if (this == &other)
+					return *this;
+				reset();
+				_pool = other._pool;
+				_index = other._index;
+				other._pool = nullptr;
+				return *this;
+			}
+
+			handle(const handle&) = delete;
+			handle& operator =(const handle&) = delete;
+
+			~handle()
+			{ reset(); }
+
+			explicit operator bool() const
+			{ return _pool != nullptr; }
+
+			T& operator *() const
+			{ return _pool->_resources[_index]; }
+
+			T* operator ->() const
+			{ return &_pool->_resources[_index]; }
+
+			/// @brief Returns the resource to the pool
+			void reset()
+			{
+				if (!_pool)
+					return;
+				_pool->release(_index);
+				_pool = nullptr;
+			}
+		};
+
+	private:
+		std::vector<T>                               _resources;
+		std::unique_ptr<std::atomic<std::uint32_t>[]> _next;
+		std::atomic<std::uint64_t>                   _head; ///< ABA tag in the upper half, index of the top free resource in the lower
+		std::atomic<size_t>                          _waitersCount{0};
+		std::mutex                                   _mutex;
+		waiter*                                      _first{nullptr};
+		waiter*                                      _last{nullptr};
+
+	public:
+		explicit resource_pool(std::vector<T> resources) :
+			_resources(std::move(resources)), _next(new std::atomic<std::uint32_t>[_resources.size()]), _head(Npos)
+		{
+			RETHREAD_ASSERT(_resources.size() < Npos, "Too many resources!");
+			for (size_t i = _resources.size(); i != 0; --i)
+				push_free(static_cast<std::uint32_t>(i - 1));
+		}
+
+		resource_pool(const resource_pool&) = delete;
+		resource_pool& operator =(const resource_pool&) = delete;
+
+		~resource_pool()
+		{ RETHREAD_ASSERT(_first == nullptr, "Pool destroyed while there are waiters!"); }
+
+		size_t size() const
+		{ return _resources.size(); }
+
+		size_t waiters_count() const
+		{ return _waitersCount.load(std::memory_order_relaxed); }
+
+		/// @returns Empty handle if there are no free resources
+		handle try_acquire()
+		{
+			std::uint32_t index = pop_free();
+			return index == Npos ? handle() : handle(this, index);
+		}
+
+		/// @brief Waits for a free resource in FIFO order
+		/// @returns Empty handle if the token was cancelled
+		handle acquire(const cancellation_token& token)
+		{
+			std::uint32_t index = Npos;
+			if (_waitersCount.load(std::memory_order_seq_cst) == 0 && (index = pop_free()) != Npos)
+				return handle(this, index);
+
+			std::unique_lock<std::mutex> l(_mutex);
+			_waitersCount.fetch_add(1, std::memory_order_seq_cst);
+			// Rechecked after announcing the waiter: release() either sees the counter or has pushed the resource already
+			if (_first == nullptr && (index = pop_free()) != Npos)
+			{
+				_waitersCount.fetch_sub(1, std::memory_order_relaxed);
+				return handle(this, index);
+			}
+
+			waiter w;
+			enqueue(w);
+			rethread::wait(w.cv, l, token, [&w] { return w.index != Npos; });
+			if (w.index == Npos)
+				dequeue(w);
+			_waitersCount.fetch_sub(1, std::memory_order_relaxed);
+			return w.index == Npos ? handle() : handle(this, w.index);
+		}
+
+	private:
+		void release(std::uint32_t index)
+		{
+			if (_waitersCount.load(std::memory_order_seq_cst) != 0)
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				if (_first)
+				{
+					hand_off(index);
+					return;
+				}
+			}
+
+			push_free(index);
+			if (_waitersCount.load(std::memory_order_seq_cst) == 0)
+				return;
+
+			// A waiter may have missed the push, give it what is free
+			std::unique_lock<std::mutex> l(_mutex);
+			while (_first && (index = pop_free()) != Npos)
+				hand_off(index);
+		}
+
+		void hand_off(std::uint32_t index)
+		{
+			waiter* w = _first;
+			dequeue(*w);
+			w->index = index;
+			w->cv.notify_one();
+		}
+
+		void enqueue(waiter& w)
+		{
+			w.prev = _last;
+			if (_last)
+				_last->next = &w;
+			else
+				_first = &w;
+			_last = &w;
+		}
+
+		void dequeue(waiter& w)
+		{
+			(w.prev ? w.prev->next : _first) = w.next;
+			(w.next ? w.next->prev : _last) = w.prev;
+			w.prev = w.next = nullptr;
+		}
+
+		void push_free(std::uint32_t index)
+		{
+			std::uint64_t head = _head.load(std::memory_order_relaxed);
+			do
+				_next[index].store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+			while (!_head.compare_exchange_weak(head, next_tag(head) | index, std::memory_order_seq_cst, std::memory_order_relaxed));
+		}
+
+		std::uint32_t pop_free()
+		{
+			std::uint64_t head = _head.load(std::memory_order_seq_cst);
+			while (static_cast<std::uint32_t>(head) != Npos)
+			{
+				std::uint32_t index = static_cast<std::uint32_t>(head);
+				std::uint32_t next = _next[index].load(std::memory_order_relaxed);
+				if (_head.compare_exchange_weak(head, next_tag(head) | next, std::memory_order_seq_cst, std::memory_order_seq_cst))
+					return index;
+			}
+			return Npos;
+		}
+
+		static std::uint64_t next_tag(std::uint64_t head)
+		{ return ((head >> 32) + 1) << 32; }
+	};
+
+}
+
+#endif
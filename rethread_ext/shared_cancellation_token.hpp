@@ -0,0 +1,301 @@
+#ifndef RETHREAD_EXT_SHARED_CANCELLATION_TOKEN_HPP
+#define RETHREAD_EXT_SHARED_CANCELLATION_TOKEN_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Linux only: cancellation across processes. The flag lives in shared memory and doubles as a process-shared futex,
+// so cancel() is a single atomic store and a wake-up syscall, and may be called from any process that maps the memory
+
+#if ATOMIC_INT_LOCK_FREE != 2
+#	error std::atomic<std::uint32_t> has to be lock-free to be shared between processes
+#endif
+
+namespace rethread
+{
+
+	/// @brief Cancellation flag to be placed in shared memory, zero bytes make a state that is not cancelled
+	/// @details cancel(), reset(), is_cancelled() and wait_for() are plain atomics and futex calls, so they may be used in a forked child of a multithreaded process
+	class shared_cancellation_state
+	{
+		friend class shared_cancellation_token;
+
+		static RETHREAD_CONSTEXPR std::uint32_t CancelledFlag = 1;
+		static RETHREAD_CONSTEXPR std::uint32_t ResetIncrement = 2;
+
+		std::atomic<std::uint32_t> _word{0}; ///< cancelled flag in the lowest bit, count of resets in the rest, so that a waiter can't miss a reset followed by cancel()
+
+	public:
+		shared_cancellation_state() { }
+		shared_cancellation_state(const shared_cancellation_state&) = delete;
+		shared_cancellation_state& operator =(const shared_cancellation_state&) = delete;
+
+		void cancel()
+		{
+			if ((_word.fetch_or(CancelledFlag, std::memory_order_release) & CancelledFlag) == 0)
+				wake();
+		}
+
+		/// @details Also wakes the tokens of other processes up, so that they notice the state is not cancelled anymore
+		void reset()
+		{
+			std::uint32_t word = _word.load(std::memory_order_relaxed);
+			do
+			{
+				if ((word & CancelledFlag) == 0)
+					return;
+			} while (!_word.compare_exchange_weak(word, (word & ~CancelledFlag) + ResetIncrement, std::memory_order_release, std::memory_order_relaxed));
+			wake();
+		}
+
+		bool is_cancelled() const
+		{ return (_word.load(std::memory_order_acquire) & CancelledFlag) != 0; }
+
+		/// @returns Whether the state is cancelled
+		bool wait_for(const std::chrono::nanoseconds& duration) const
+		{
+			auto end_time = std::chrono::steady_clock::now() + duration;
+			std::uint32_t word = 0;
+			while (((word = _word.load(std::memory_order_acquire)) & CancelledFlag) == 0)
+			{
+				auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - std::chrono::steady_clock::now());
+				if (remaining.count() <= 0)
+					return false;
+				wait_while(word, &remaining);
+			}
+			return true;
+		}
+
+	private:
+		/// @brief Blocks while the word equals value, may wake up spuriously
+		void wait_while(std::uint32_t value, const std::chrono::nanoseconds* timeout = nullptr) const
+		{
+			timespec ts = { };
+			if (timeout)
+			{
+				ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+				ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+			}
+			::syscall(SYS_futex, &_word, FUTEX_WAIT, value, timeout ? &ts : nullptr, nullptr, 0);
+		}
+
+		void wake() const
+		{ ::syscall(SYS_futex, &_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0); }
+	};
+
+	static_assert(sizeof(shared_cancellation_state) == sizeof(std::uint32_t), "The futex word must be the only member!");
+
+
+	/// @brief Array of shared_cancellation_state in a MAP_SHARED mapping
+	/// @details The anonymous mapping is inherited by the children forked afterwards, the other constructor maps a file from shm_open() or memfd_create()
+	class shared_cancellation_segment
+	{
+		shared_cancellation_state* _states;
+		size_t                     _size;
+
+	public:
+		explicit shared_cancellation_segment(size_t size) :
+			_states(map(-1, size)), _size(size)
+		{
+			for (size_t i = 0; i < size; ++i)
+				new(_states + i) shared_cancellation_state();
+		}
+
+		/// @details The file must be at least size * sizeof(shared_cancellation_state) bytes long, the states are used as they are
+		shared_cancellation_segment(int fd, size_t size) :
+			_states(map(fd, size)), _size(size)
+		{ }
+
+		shared_cancellation_segment(shared_cancellation_segment&& other) :
+			_states(other._states), _size(other._size)
+		{
+			other._states = nullptr;
+			other._size = 0;
+		}
+
+		shared_cancellation_segment(const shared_cancellation_segment&) = delete;
+		shared_cancellation_segment& operator =(const shared_cancellation_segment&) = delete;
+
+		~shared_cancellation_segment()
+		{
+			if (_states)
+				::munmap(_states, _size * sizeof(shared_cancellation_state));
+		}
+
+		size_t size() const
+		{ return _size; }
+
+		shared_cancellation_state& operator [](size_t i) const
+		{ return _states[i]; }
+
+	private:
+		static shared_cancellation_state* map(int fd, size_t size)
+		{
+			RETHREAD_ASSERT(size != 0, "Empty segment!");
+			void* result = ::mmap(nullptr, size * sizeof(shared_cancellation_state), PROT_READ | PROT_WRITE, fd == -1 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+			RETHREAD_CHECK(result != MAP_FAILED, std::system_error(errno, std::system_category()));
+			return static_cast<shared_cancellation_state*>(result);
+		}
+	};
+
+
+	/// @brief Token of this process for a shared_cancellation_state, works with rethread::wait, sleep_for, poll etc.
+	/// @details sleep_for() blocks on the futex directly. A watcher thread blocks on it as well, mirrors the state into is_cancelled()
+	/// and calls the registered handler, so cancellation from another process reaches a handler through one extra thread wake-up.
+	/// Create the tokens after fork(), the child doesn't get the watcher thread of the parent
+	class shared_cancellation_token : public cancellation_token
+	{
+		shared_cancellation_state&      _state;
+		mutable std::mutex              _mutex;
+		mutable std::condition_variable _cv;
+		mutable cancellation_handler*   _handler{nullptr};
+		mutable bool                    _handlerCalled{false};
+		mutable bool                    _handlerDone{false};
+		bool                            _stop{false};
+		bool                            _watcherExited{false};
+		std::thread                     _watcher;
+
+	public:
+		explicit shared_cancellation_token(shared_cancellation_state& state) :
+			_state(state)
+		{
+			_cancelled.store(state.is_cancelled(), std::memory_order_release);
+			_watcher = std::thread(&shared_cancellation_token::watch, this);
+		}
+
+		shared_cancellation_token(const shared_cancellation_token&) = delete;
+		shared_cancellation_token& operator =(const shared_cancellation_token&) = delete;
+
+		/// @details Wakes up the watchers of the other processes spuriously, they block again
+		~shared_cancellation_token()
+		{
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				RETHREAD_ASSERT(_handler == nullptr, "Cancellation handler is still registered!");
+				_stop = true;
+				// The watcher may be just about to block on the futex, in which case the wake-up is lost
+				while (!_watcherExited)
+				{
+					l.unlock();
+					_state.wake();
+					l.lock();
+					_cv.wait_for(l, std::chrono::milliseconds(1), [this] { return _watcherExited; });
+				}
+			}
+			_watcher.join();
+		}
+
+		/// @brief Cancels the shared state, the handlers are called by the watcher threads, i.e. possibly after cancel() returns
+		/// @details Under the mutex, so that the watcher can't store the old state into is_cancelled() afterwards
+		void cancel()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_state.cancel();
+			_cancelled.store(true, std::memory_order_release);
+		}
+
+		/// @details Under the mutex for the same reason as cancel()
+		void reset()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			_state.reset();
+			_cancelled.store(false, std::memory_order_release);
+		}
+
+		shared_cancellation_state& state() const
+		{ return _state; }
+
+	protected:
+		void do_sleep_for(const std::chrono::nanoseconds& duration) const override
+		{ _state.wait_for(duration); }
+
+		bool try_register_cancellation_handler(cancellation_handler& handler) const override
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			RETHREAD_ASSERT(_handler == nullptr, "Cancellation handler is already registered!");
+			if (_state.is_cancelled())
+				return false;
+
+			_handler = &handler;
+			_handlerCalled = false;
+			_handlerDone = false;
+			return true;
+		}
+
+		bool try_unregister_cancellation_handler(cancellation_handler&) const override
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			if (_handlerCalled)
+				return false;
+			_handler = nullptr;
+			return true;
+		}
+
+		void unregister_cancellation_handler(cancellation_handler& handler) const override
+		{
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				while (!_handlerDone)
+					_cv.wait(l);
+				_handler = nullptr;
+			}
+			handler.reset();
+		}
+
+	private:
+		void watch()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			while (!_stop)
+			{
+				std::uint32_t value = _state._word.load(std::memory_order_acquire);
+				bool cancelled = (value & shared_cancellation_state::CancelledFlag) != 0;
+				_cancelled.store(cancelled, std::memory_order_release);
+				if (cancelled && _handler && !_handlerCalled)
+				{
+					cancellation_handler* handler = _handler;
+					_handlerCalled = true;
+					l.unlock();
+					handler->cancel();
+					l.lock();
+					_handlerDone = true;
+					_cv.notify_all();
+				}
+
+				l.unlock();
+				_state.wait_while(value);
+				l.lock();
+			}
+			_watcherExited = true;
+			_cv.notify_all();
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef RETHREAD_EXT_SPLICE_HPP
+#define RETHREAD_EXT_SPLICE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/poll.hpp>
+
+#include <rethread_ext/io.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Linux only: zero-copy cancellable transfers between descriptors. As in rethread_ext/io.hpp, the descriptors must be non-blocking,
+// and the syscall is tried first, readiness is waited for with rethread::poll.
+// The result is the number of bytes written to out_fd. If nothing was written, -1 with errno (ECANCELED on cancellation),
+// or 0 on end of input or if out_fd doesn't take any more data
+
+namespace rethread
+{
+
+	namespace detail
+	{
+		static RETHREAD_CONSTEXPR int SplicePipeSize = 1 << 20;
+
+
+		/// @brief Intermediate pipe for splice(), kept per thread because creating and resizing it dominates small transfers
+		class splice_pipe
+		{
+			int    _fds[2];
+			size_t _capacity;
+
+		public:
+			splice_pipe() :
+				_capacity(0)
+			{
+				if (::pipe2(_fds, O_NONBLOCK | O_CLOEXEC) != 0)
+				{
+					_fds[0] = _fds[1] = -1;
+					return;
+				}
+				int size = ::fcntl(_fds[1], F_SETPIPE_SZ, SplicePipeSize);
+				if (size == -1)
+					size = ::fcntl(_fds[1], F_GETPIPE_SZ);
+				_capacity = size > 0 ? static_cast<size_t>(size) : 65536;
+			}
+
+			splice_pipe(const splice_pipe&) = delete;
+			splice_pipe& operator =(const splice_pipe&) = delete;
+
+			~splice_pipe()
+			{
+				if (_fds[0] == -1)
+					return;
+				::close(_fds[0]);
+				::close(_fds[1]);
+			}
+
+			bool valid() const       { return _fds[0] != -1; }
+			int read_fd() const      { return _fds[0]; }
+			int write_fd() const     { return _fds[1]; }
+			size_t capacity() const  { return _capacity; }
+
+			/// @returns Pipe of the calling thread, empty
+			static splice_pipe* get()
+			{
+				std::unique_ptr<splice_pipe>& instance = thread_instance();
+				if (!instance || !instance->valid())
+					instance.reset(new splice_pipe);
+				return instance->valid() ? instance.get() : nullptr;
+			}
+
+			/// @brief Throws away the pipe of the calling thread, if there is data left in it
+			static void discard()
+			{ thread_instance().reset(); }
+
+		private:
+			static std::unique_ptr<splice_pipe>& thread_instance()
+			{
+				static thread_local std::unique_ptr<splice_pipe> instance;
+				return instance;
+			}
+		};
+
+		/// @brief Moves up to count bytes between the descriptors, one of which is a pipe
+		/// @returns Result of ::splice, or -1 with ECANCELED if the token was cancelled while the wait_fd was not ready
+		inline ssize_t splice_some(int in_fd, int out_fd, size_t count, int wait_fd, short wait_events, const cancellation_token& token)
+		{
+			return cancellable_io<ssize_t>(wait_fd, wait_events, token,
+				[=] { return ::splice(in_fd, nullptr, out_fd, nullptr, count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK); });
+		}
+
+
+		/// @brief Moves from the pipe what out_fd takes without waiting
+		/// @returns Number of bytes moved, errno is left as it was
+		inline size_t flush_pipe(const splice_pipe& pipe, int out_fd, size_t pending)
+		{
+			int error = errno;
+			size_t result = 0;
+			while (result < pending)
+			{
+				ssize_t written = ::splice(pipe.read_fd(), nullptr, out_fd, nullptr, pending - result, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+				if (written <= 0)
+					break;
+				result += static_cast<size_t>(written);
+			}
+			errno = error;
+			return result;
+		}
+
+
+		/// @brief Converts the amount written and the result of the last syscall into the return value
+		inline ssize_t transfer_result(size_t transferred, ssize_t last_result)
+		{ return transferred != 0 ? static_cast<ssize_t>(transferred) : last_result; }
+	}
+
+
+	/// @brief Moves up to count bytes from in_fd to out_fd through a kernel pipe, without copying them to user space
+	/// @param stranded Set to the number of bytes that were read from in_fd but couldn't be written to out_fd, because the token was cancelled or out_fd failed.
+	/// After cancellation whatever out_fd takes without waiting is still written. If stranded is not zero, the bytes are lost (at most the pipe size, 1 MB)
+	/// and the stream is broken, unless in_fd is seekable and the caller rewinds it by that amount. Use sendfile() when in_fd is a regular file
+	inline ssize_t splice(int in_fd, int out_fd, size_t count, const cancellation_token& token, size_t& stranded)
+	{
+		stranded = 0;
+		detail::splice_pipe* pipe = detail::splice_pipe::get();
+		if (!pipe)
+			return -1;
+
+		size_t transferred = 0;
+		while (transferred < count)
+		{
+			ssize_t pending = detail::splice_some(in_fd, pipe->write_fd(), std::min(count - transferred, pipe->capacity()), in_fd, POLLIN, token);
+			if (pending <= 0)
+				return detail::transfer_result(transferred, pending);
+
+			while (pending > 0)
+			{
+				ssize_t written = detail::splice_some(pipe->read_fd(), out_fd, static_cast<size_t>(pending), out_fd, POLLOUT, token);
+				if (written <= 0)
+				{
+					if (written < 0 && errno == ECANCELED)
+					{
+						size_t flushed = detail::flush_pipe(*pipe, out_fd, static_cast<size_t>(pending));
+						pending -= static_cast<ssize_t>(flushed);
+						transferred += flushed;
+					}
+					stranded = static_cast<size_t>(pending);
+					if (stranded != 0)
+						detail::splice_pipe::discard();
+					return detail::transfer_result(transferred, written);
+				}
+				pending -= written;
+				transferred += static_cast<size_t>(written);
+			}
+		}
+		return static_cast<ssize_t>(transferred);
+	}
+
+
+	/// @brief Same as ::sendfile, in_fd must support mmap-like operations (i.e. be a regular file). Nothing is lost on cancellation
+	inline ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count, const cancellation_token& token)
+	{
+		size_t transferred = 0;
+		while (transferred < count)
+		{
+			ssize_t result = detail::cancellable_io<ssize_t>(out_fd, POLLOUT, token,
+				[=] { return ::sendfile(out_fd, in_fd, offset, count - transferred); });
+			if (result <= 0)
+				return detail::transfer_result(transferred, result);
+			transferred += static_cast<size_t>(result);
+		}
+		return static_cast<ssize_t>(transferred);
+	}
+
+}
+
+#endif
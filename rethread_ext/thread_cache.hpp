@@ -0,0 +1,256 @@
+#ifndef RETHREAD_EXT_THREAD_CACHE_HPP
+#define RETHREAD_EXT_THREAD_CACHE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rethread
+{
+
+	class thread_cache;
+
+
+	namespace detail
+	{
+		/// @brief OS thread that runs one job at a time, each with a fresh token
+		class cached_worker
+		{
+			using job = std::function<void(const cancellation_token&)>;
+
+			std::mutex                    _mutex;
+			std::condition_variable       _cv;
+			job                           _job;
+			bool                          _running{false};
+			bool                          _stopping{false};
+			standalone_cancellation_token _token;
+			std::thread                   _thread;
+
+		public:
+			explicit cached_worker(job j) :
+				_job(std::move(j)), _running(true)
+			{ _thread = std::thread(&cached_worker::run, this); }
+
+			cached_worker(const cached_worker&) = delete;
+			cached_worker& operator =(const cached_worker&) = delete;
+
+			~cached_worker()
+			{
+				{
+					std::unique_lock<std::mutex> l(_mutex);
+					_stopping = true;
+					_cv.notify_all();
+				}
+				_thread.join();
+			}
+
+			std::thread::id get_id() const
+			{ return _thread.get_id(); }
+
+			std::thread::native_handle_type native_handle()
+			{ return _thread.native_handle(); }
+
+			void start(job j)
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				_job = std::move(j);
+				_running = true;
+				_cv.notify_all();
+			}
+
+			/// @brief Cancels the job and waits for it to finish. The token is reset for the next one
+			void cancel_and_join()
+			{
+				_token.cancel();
+				std::unique_lock<std::mutex> l(_mutex);
+				while (_running)
+					_cv.wait(l);
+				_token.reset();
+			}
+
+		private:
+			void run()
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				while (true)
+				{
+					while (!_running && !_stopping)
+						_cv.wait(l);
+					if (!_running)
+						return;
+
+					job j;
+					j.swap(_job);
+					l.unlock();
+					j(_token);
+					j = nullptr;
+					l.lock();
+
+					_running = false;
+					_cv.notify_all();
+				}
+			}
+		};
+	}
+
+
+	/// @brief Parked OS threads for cached_thread
+	/// @details Up to max_idle threads are kept parked after their jobs have finished, the rest exit.
+	/// All the cached_threads must be reset before the cache is destroyed
+	class thread_cache
+	{
+		friend class cached_thread;
+
+		std::mutex                                          _mutex;
+		std::vector<std::unique_ptr<detail::cached_worker>> _idle;
+		size_t                                              _maxIdle;
+
+	public:
+		explicit thread_cache(size_t max_idle = std::max(1u, std::thread::hardware_concurrency())) :
+			_maxIdle(max_idle)
+		{ }
+
+		thread_cache(const thread_cache&) = delete;
+		thread_cache& operator =(const thread_cache&) = delete;
+
+		/// @brief Cache used by cached_thread unless another one is given. Keeps hardware_concurrency() threads
+		static thread_cache& default_instance()
+		{
+			static thread_cache instance;
+			return instance;
+		}
+
+		size_t idle_count()
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			return _idle.size();
+		}
+
+		/// @brief Lets all the parked threads exit
+		void clear()
+		{
+			std::vector<std::unique_ptr<detail::cached_worker>> idle;
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				idle.swap(_idle);
+			}
+		}
+
+	private:
+		std::unique_ptr<detail::cached_worker> start(std::function<void(const cancellation_token&)> job)
+		{
+			std::unique_ptr<detail::cached_worker> worker;
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				if (!_idle.empty())
+				{
+					worker = std::move(_idle.back());
+					_idle.pop_back();
+				}
+			}
+
+			if (!worker)
+				return std::unique_ptr<detail::cached_worker>(new detail::cached_worker(std::move(job)));
+			worker->start(std::move(job));
+			return worker;
+		}
+
+		void park(std::unique_ptr<detail::cached_worker> worker)
+		{
+			std::unique_lock<std::mutex> l(_mutex);
+			if (_idle.size() < _maxIdle)
+				_idle.push_back(std::move(worker));
+			else
+			{
+				l.unlock();
+				worker.reset();
+			}
+		}
+	};
+
+
+	/// @brief Drop-in for rethread::thread that takes its OS thread from a thread_cache
+	/// @details Same semantics: the function gets the arguments followed by a token, reset() and the destructor cancel the token and wait for the function to return.
+	/// Thread-local variables of the OS thread survive between jobs. There is no detach()
+	class cached_thread
+	{
+		thread_cache*                          _cache;
+		std::unique_ptr<detail::cached_worker> _worker;
+
+	public:
+		using id = std::thread::id;
+		using native_handle_type = std::thread::native_handle_type;
+
+		cached_thread() :
+			_cache(nullptr)
+		{ }
+
+		template <typename Func_, typename... Args_>
+		explicit cached_thread(Func_&& func, Args_&&... args) :
+			_cache(&thread_cache::default_instance()),
+			_worker(_cache->start(std::bind(std::forward<Func_>(func), std::forward<Args_>(args)..., std::placeholders::_1)))
+		{ }
+
+		template <typename Func_, typename... Args_>
+		cached_thread(thread_cache& cache, Func_&& func, Args_&&... args) :
+			_cache(&cache),
+			_worker(_cache->start(std::bind(std::forward<Func_>(func), std::forward<Args_>(args)..., std::placeholders::_1)))
+		{ }
+
+		cached_thread(cached_thread&& other) :
+			_cache(other._cache), _worker(std::move(other._worker))
+		{ }
+
+		cached_thread& operator =(cached_thread&& other)
+		{
+			if (this == &other)
+				return *this;
+			reset();
+			_cache = other._cache;
+			_worker = std::move(other._worker);
+			return *this;
+		}
+
+		cached_thread(const cached_thread&) = delete;
+		cached_thread& operator =(const cached_thread&) = delete;
+
+		~cached_thread()
+		{ reset(); }
+
+		bool joinable() const
+		{ return _worker != nullptr; }
+
+		id get_id() const
+		{ return _worker ? _worker->get_id() : id(); }
+
+		native_handle_type native_handle()
+		{ return _worker->native_handle(); }
+
+		/// @brief Cancels the function, waits for it to return and gives the OS thread back to the cache
+		void reset()
+		{
+			if (!_worker)
+				return;
+			_worker->cancel_and_join();
+			_cache->park(std::move(_worker));
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RETHREAD_EXT_TIMED_WAIT_HPP
+#define RETHREAD_EXT_TIMED_WAIT_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Timed counterparts of rethread::wait. The handler is registered with the token once per call, however many times the condition wakes up.
+// Parameters follow rethread::this_thread::sleep_for: the time goes before the token, the predicate comes last as in rethread::wait
+
+namespace rethread
+{
+
+	enum class wait_result
+	{
+		ready,    ///< notified (or woken up spuriously, for the overloads without a predicate), or the predicate is satisfied
+		timeout,
+		cancelled
+	};
+
+
+	namespace detail
+	{
+		/// @brief Notifies under the mutex, so that a waiter that has checked the token while holding it can't miss the notification
+		template <typename Condition_, typename Lock_>
+		class timed_wait_handler : public cancellation_handler
+		{
+			Condition_& _cv;
+			Lock_&      _lock;
+
+		public:
+			timed_wait_handler(Condition_& cv, Lock_& lock) :
+				_cv(cv), _lock(lock)
+			{ }
+
+			void cancel() override
+			{
+				std::unique_lock<typename Lock_::mutex_type> l(*_lock.mutex());
+				_cv.notify_all();
+			}
+		};
+
+
+		template <typename Lock_>
+		struct relock_on_exit
+		{
+			Lock_& lock;
+			~relock_on_exit() { lock.lock(); }
+		};
+
+
+		template <typename Lock_>
+		struct unlock_on_exit
+		{
+			Lock_& lock;
+			~unlock_on_exit() { lock.unlock(); }
+		};
+	}
+
+
+	/// @brief Waits for a notification until the deadline
+	template <typename Condition_, typename Lock_, typename Clock_, typename Duration_>
+	wait_result wait_until(Condition_& cv, Lock_& lock, const std::chrono::time_point<Clock_, Duration_>& deadline, const cancellation_token& token)
+	{
+		detail::timed_wait_handler<Condition_, Lock_> handler(cv, lock);
+		// The handler takes the mutex, so it is unregistered with the lock released: unlock, unregister, relock
+		detail::relock_on_exit<Lock_> relock = { lock };
+		cancellation_guard guard(token, handler);
+		detail::unlock_on_exit<Lock_> unlock = { lock };
+
+		if (token.is_cancelled())
+			return wait_result::cancelled;
+		if (cv.wait_until(lock, deadline) == std::cv_status::timeout)
+			return wait_result::timeout;
+		return token.is_cancelled() ? wait_result::cancelled : wait_result::ready;
+	}
+
+
+	/// @brief Waits until the predicate is satisfied or the deadline is reached
+	/// @details The predicate is checked first, so a satisfied predicate wins over cancellation and timeout
+	template <typename Condition_, typename Lock_, typename Clock_, typename Duration_, typename Predicate_>
+	wait_result wait_until(Condition_& cv, Lock_& lock, const std::chrono::time_point<Clock_, Duration_>& deadline, const cancellation_token& token, Predicate_ pred)
+	{
+		if (pred())
+			return wait_result::ready;
+
+		detail::timed_wait_handler<Condition_, Lock_> handler(cv, lock);
+		detail::relock_on_exit<Lock_> relock = { lock };
+		cancellation_guard guard(token, handler);
+		detail::unlock_on_exit<Lock_> unlock = { lock };
+
+		while (!pred())
+		{
+			if (token.is_cancelled())
+				return wait_result::cancelled;
+			if (cv.wait_until(lock, deadline) == std::cv_status::timeout)
+				return pred() ? wait_result::ready : wait_result::timeout;
+		}
+		return wait_result::ready;
+	}
+
+
+	template <typename Condition_, typename Lock_, typename Rep_, typename Period_>
+	wait_result wait_for(Condition_& cv, Lock_& lock, const std::chrono::duration<Rep_, Period_>& duration, const cancellation_token& token)
+	{ return rethread::wait_until(cv, lock, std::chrono::steady_clock::now() + duration, token); }
+
+
+	template <typename Condition_, typename Lock_, typename Rep_, typename Period_, typename Predicate_>
+	wait_result wait_for(Condition_& cv, Lock_& lock, const std::chrono::duration<Rep_, Period_>& duration, const cancellation_token& token, Predicate_ pred)
+	{ return rethread::wait_until(cv, lock, std::chrono::steady_clock::now() + duration, token, pred); }
+
+}
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef RETHREAD_EXT_TRACE_HPP
+#define RETHREAD_EXT_TRACE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Cancellation tracing and metrics. Compiled in with RETHREAD_TRACING, otherwise every hook is empty and collect() returns zeroes.
+// Durations are recorded into per-thread lock-free ring buffers and aggregated into counters and log2 histograms by collect().
+// Only the calls made through rethread::traced and async_canceller are measured: the rethread submodule and the rest of rethread_ext
+// call rethread directly, so e.g. the guard registered inside rethread::wait or the waits of pipeline are not recorded.
+// The implementation lives in an inline namespace named after the mode, so translation units built with and without tracing can be linked together.
+// Classes outside of rethread::trace that keep trace state in their layout go into the inline namespace RETHREAD_TRACE_ABI_NAMESPACE of rethread.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+#include <rethread/thread.hpp>
+
+#if defined(RETHREAD_HAS_POLL)
+#	include <rethread/poll.hpp>
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(RETHREAD_TRACING)
+#	define RETHREAD_TRACE_NAMESPACE enabled
+#	define RETHREAD_TRACE_ABI_NAMESPACE trace_enabled
+#	define RETHREAD_TRACE_CONCAT_IMPL(A_, B_) A_##B_
+#	define RETHREAD_TRACE_CONCAT(A_, B_) RETHREAD_TRACE_CONCAT_IMPL(A_, B_)
+#	define RETHREAD_TRACE_SCOPE(Event_) ::rethread::trace::scope RETHREAD_TRACE_CONCAT(rethread_trace_scope_, __LINE__)(Event_)
+#else
+#	define RETHREAD_TRACE_NAMESPACE disabled
+#	define RETHREAD_TRACE_ABI_NAMESPACE trace_disabled
+#	define RETHREAD_TRACE_SCOPE(Event_) do { } while (false)
+#endif
+
+namespace rethread {
+namespace trace {
+inline namespace RETHREAD_TRACE_NAMESPACE
+{
+
+	enum class event : std::uint8_t
+	{
+		token_cancel,    ///< duration of cancel(), i.e. from cancel() to completion of the handlers
+		guard,           ///< time a cancellation_guard stayed registered
+		wait,
+		sleep_for,
+		poll,
+		thread_reset,
+		async_cancel,    ///< from async_canceller::cancel() to completion of the handlers on the dispatcher
+		count
+	};
+
+	static RETHREAD_CONSTEXPR size_t EventsCount = static_cast<size_t>(event::count);
+	static RETHREAD_CONSTEXPR size_t HistogramSize = 64;
+
+
+	inline const char* event_name(event e)
+	{
+		static const char* const names[EventsCount] = { "token_cancel", "guard", "wait", "sleep_for", "poll", "thread_reset", "async_cancel" };
+		return names[static_cast<size_t>(e)];
+	}
+
+
+	struct event_metrics
+	{
+		std::uint64_t                              count{0};
+		std::uint64_t                              total_ns{0};
+		std::uint64_t                              max_ns{0};
+		std::array<std::uint64_t, HistogramSize>   histogram; ///< histogram[i] counts durations in [2^(i-1), 2^i) ns
+
+		event_metrics()
+		{ histogram.fill(0); }
+
+		void add(std::uint64_t duration_ns)
+		{
+			++count;
+			total_ns += duration_ns;
+			if (duration_ns > max_ns)
+				max_ns = duration_ns;
+			size_t bucket = 0;
+			while (bucket + 1 < HistogramSize && (duration_ns >> bucket) != 0)
+				++bucket;
+			++histogram[bucket];
+		}
+	};
+
+
+	struct metrics
+	{
+		std::array<event_metrics, EventsCount> events;
+		std::uint64_t                          dropped{0}; ///< records lost because a ring buffer was full
+
+		const event_metrics& operator [](event e) const
+		{ return events[static_cast<size_t>(e)]; }
+	};
+
+
+#if defined(RETHREAD_TRACING)
+
+	namespace detail
+	{
+		/// @brief Single-producer ring of records packed as duration << 8 | event. Only the owning thread writes
+		class thread_buffer
+		{
+		public:
+			static RETHREAD_CONSTEXPR size_t Size = 4096;
+
+		private:
+			std::array<std::atomic<std::uint64_t>, Size> _records;
+			std::atomic<size_t>                          _head{0};
+			std::atomic<size_t>                          _tail{0};
+			std::atomic<std::uint64_t>                   _dropped{0};
+
+		public:
+			void push(event e, std::uint64_t duration_ns)
+			{
+				size_t head = _head.load(std::memory_order_relaxed);
+				if (head - _tail.load(std::memory_order_acquire) >= Size)
+				{
+					_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				_records[head % Size].store(duration_ns << 8 | static_cast<std::uint64_t>(e), std::memory_order_relaxed);
+				_head.store(head + 1, std::memory_order_release);
+			}
+
+			void drain(metrics& m)
+			{
+				size_t tail = _tail.load(std::memory_order_relaxed);
+				size_t head = _head.load(std::memory_order_acquire);
+				for (; tail != head; ++tail)
+				{
+					std::uint64_t record = _records[tail % Size].load(std::memory_order_relaxed);
+					m.events[record & 0xFF].add(record >> 8);
+				}
+				_tail.store(tail, std::memory_order_release);
+				m.dropped += _dropped.exchange(0, std::memory_order_relaxed);
+			}
+		};
+
+
+		class registry
+		{
+			std::mutex                                  _mutex;
+			std::vector<std::shared_ptr<thread_buffer>> _buffers;
+			metrics                                     _metrics;
+
+		public:
+			std::atomic<unsigned>                       sample_rate{1};
+
+			static registry& instance()
+			{
+				static registry r;
+				return r;
+			}
+
+			std::shared_ptr<thread_buffer> create_buffer()
+			{
+				std::shared_ptr<thread_buffer> result = std::make_shared<thread_buffer>();
+				std::unique_lock<std::mutex> l(_mutex);
+				_buffers.push_back(result);
+				return result;
+			}
+
+			/// @brief Buffers of finished threads are drained one last time and released
+			metrics collect()
+			{
+				std::unique_lock<std::mutex> l(_mutex);
+				for (size_t i = 0; i < _buffers.size(); )
+				{
+					_buffers[i]->drain(_metrics);
+					if (_buffers[i].use_count() == 1)
+					{
+						_buffers[i] = _buffers.back();
+						_buffers.pop_back();
+					}
+					else
+						++i;
+				}
+				return _metrics;
+			}
+
+			void reset()
+			{
+				collect();
+				std::unique_lock<std::mutex> l(_mutex);
+				_metrics = metrics();
+			}
+		};
+
+
+		struct thread_state
+		{
+			std::shared_ptr<thread_buffer> buffer;
+			unsigned                       counter{0};
+
+			static thread_state& instance()
+			{
+				static thread_local thread_state s;
+				return s;
+			}
+		};
+	}
+
+
+	/// @brief 0 turns recording off, 1 records every event, N records every N-th event of each thread
+	inline void set_sample_rate(unsigned rate)
+	{ detail::registry::instance().sample_rate.store(rate, std::memory_order_relaxed); }
+
+
+	/// @returns Whether the current event of the calling thread has to be recorded
+	inline bool sampled()
+	{
+		unsigned rate = detail::registry::instance().sample_rate.load(std::memory_order_relaxed);
+		if (rate == 0)
+			return false;
+		if (rate == 1)
+			return true;
+		detail::thread_state& s = detail::thread_state::instance();
+		if (++s.counter < rate)
+			return false;
+		s.counter = 0;
+		return true;
+	}
+
+
+	inline void record(event e, std::chrono::nanoseconds duration)
+	{
+		detail::thread_state& s = detail::thread_state::instance();
+		if (RETHREAD_UNLIKELY(!s.buffer))
+			s.buffer = detail::registry::instance().create_buffer();
+		s.buffer->push(e, static_cast<std::uint64_t>(duration.count()));
+	}
+
+
+	/// @brief Records the lifetime of the scope, if sampled
+	class scope
+	{
+		event                                 _event;
+		bool                                  _sampled;
+		std::chrono::steady_clock::time_point _start;
+
+	public:
+		explicit scope(event e) :
+			_event(e), _sampled(sampled())
+		{
+			if (_sampled)
+				_start = std::chrono::steady_clock::now();
+		}
+
+		scope(const scope&) = delete;
+		scope& operator =(const scope&) = delete;
+
+		~scope()
+		{
+			if (_sampled)
+				record(_event, std::chrono::steady_clock::now() - _start);
+		}
+	};
+
+
+	/// @brief Measures an interval that starts and ends in different places, possibly on different threads
+	/// @details start() and stop() must be ordered by the caller, e.g. by a mutex
+	class stopwatch
+	{
+		bool                                  _sampled{false};
+		std::chrono::steady_clock::time_point _start;
+
+	public:
+		void start()
+		{
+			_sampled = sampled();
+			if (_sampled)
+				_start = std::chrono::steady_clock::now();
+		}
+
+		void stop(event e)
+		{
+			if (_sampled)
+				record(e, std::chrono::steady_clock::now() - _start);
+		}
+	};
+
+
+	/// @brief Drains all the ring buffers. Metrics accumulate until reset()
+	inline metrics collect()
+	{ return detail::registry::instance().collect(); }
+
+
+	inline void reset()
+	{ detail::registry::instance().reset(); }
+
+#else
+
+	class stopwatch
+	{
+	public:
+		void start() { }
+		void stop(event) { }
+	};
+
+
+	inline void set_sample_rate(unsigned)
+	{ }
+
+	inline metrics collect()
+	{ return metrics(); }
+
+	inline void reset()
+	{ }
+
+#endif
+
+}
+}
+}
+
+
+namespace rethread {
+/// @brief Drop-in replacements for the rethread calls that report to rethread::trace
+namespace traced {
+inline namespace RETHREAD_TRACE_NAMESPACE
+{
+
+	template <typename Condition_, typename Lock_>
+	void wait(Condition_& cv, Lock_& lock, const cancellation_token& token)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::wait);
+		rethread::wait(cv, lock, token);
+	}
+
+
+	template <typename Condition_, typename Lock_, typename Predicate_>
+	bool wait(Condition_& cv, Lock_& lock, const cancellation_token& token, Predicate_ pred)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::wait);
+		return rethread::wait(cv, lock, token, pred);
+	}
+
+
+	template <typename Rep_, typename Period_>
+	void sleep_for(const std::chrono::duration<Rep_, Period_>& duration, const cancellation_token& token)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::sleep_for);
+		rethread::this_thread::sleep_for(duration, token);
+	}
+
+
+#if defined(RETHREAD_HAS_POLL)
+	inline short poll(int fd, short events, const cancellation_token& token)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::poll);
+		return rethread::poll(fd, events, token);
+	}
+#endif
+
+
+	inline void reset(rethread::thread& t)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::thread_reset);
+		t.reset();
+	}
+
+
+	/// @brief Works for cancellation_token_source and standalone_cancellation_token
+	template <typename Cancellable_>
+	void cancel(Cancellable_& cancellable)
+	{
+		RETHREAD_TRACE_SCOPE(trace::event::token_cancel);
+		cancellable.cancel();
+	}
+
+
+	class cancellation_guard
+	{
+#if defined(RETHREAD_TRACING)
+		trace::scope                 _scope{trace::event::guard};
+#endif
+		rethread::cancellation_guard _guard;
+
+	public:
+		cancellation_guard(const cancellation_token& token, cancellation_handler& handler) :
+			_guard(token, handler)
+		{ }
+
+		cancellation_guard(const cancellation_guard&) = delete;
+		cancellation_guard& operator =(const cancellation_guard&) = delete;
+
+		bool is_cancelled() const
+		{ return _guard.is_cancelled(); }
+	};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef RETHREAD_EXT_WATCHED_VALUE_HPP
+#define RETHREAD_EXT_WATCHED_VALUE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread/cancellation_token.hpp>
+#include <rethread/condition_variable.hpp>
+
+#include <rethread_ext/cache_line.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace rethread
+{
+
+	namespace detail
+	{
+		/// @brief Small per-thread index for the reader slots of watched_value. Indices of finished threads are reused
+		class reader_index
+		{
+		public:
+			static RETHREAD_CONSTEXPR size_t MaxReaderThreads = 256;
+
+		private:
+			size_t _index;
+
+			reader_index() :
+				_index(registry().acquire())
+			{ }
+
+			~reader_index()
+			{ registry().release(_index); }
+
+			class index_registry
+			{
+				std::mutex          _mutex;
+				std::vector<bool>   _used;
+				std::atomic<size_t> _highWater{0};
+
+			public:
+				index_registry() : _used(MaxReaderThreads, false) { }
+
+				/// @brief No index at or above this one has ever been given out
+				size_t high_water() const
+				{ return _highWater.load(std::memory_order_seq_cst); }
+
+				size_t acquire()
+				{
+					std::unique_lock<std::mutex> l(_mutex);
+					for (size_t i = 0; i < _used.size(); ++i)
+						if (!_used[i])
+						{
+							_used[i] = true;
+							if (i >= _highWater.load(std::memory_order_relaxed))
+								_highWater.store(i + 1, std::memory_order_seq_cst);
+							return i;
+						}
+					// Not RETHREAD_CHECK: with the checks suppressed, a shared slot would let reclamation free a node that is still being read
+					throw std::runtime_error("Too many threads read watched_values!");
+				}
+
+				void release(size_t index)
+				{
+					std::unique_lock<std::mutex> l(_mutex);
+					_used[index] = false;
+				}
+			};
+
+			static index_registry& registry()
+			{
+				static index_registry instance;
+				return instance;
+			}
+
+		public:
+			static size_t get()
+			{
+				static thread_local reader_index instance;
+				return instance._index;
+			}
+
+			static size_t high_water()
+			{ return registry().high_water(); }
+		};
+	}
+
+
+	/// @brief Value published by writers and read by many threads
+	/// @details read() is wait-free: it marks the reader slot of the calling thread with the current epoch and loads a pointer.
+	/// Replaced values are retired and destroyed by later writes once no reader slot has an epoch old enough to see them (epoch-based reclamation),
+	/// so a snapshot that is kept for a long time delays the reclamation, not the writers. Writers are serialized with a mutex.
+	/// Reader slots are per thread and shared by all the watched_values: at most 256 (detail::reader_index::MaxReaderThreads) live threads may have called read(),
+	/// a slot is freed when its thread exits. The first read() of one more thread throws std::runtime_error
+	template <typename T>
+	class watched_value
+	{
+		struct node
+		{
+			T             value;
+			std::uint64_t version;
+			std::uint64_t retired_epoch;
+
+			node(T v, std::uint64_t ver) : value(std::move(v)), version(ver), retired_epoch(0) { }
+		};
+
+		/// @brief Takes a cache line, see the constructor
+		struct reader_slot
+		{
+			std::atomic<std::uint64_t> epoch{0}; ///< 0 when the thread holds no snapshot
+			size_t                     depth{0}; ///< nested snapshots of the owning thread, only it touches this
+			char                       padding[RETHREAD_CACHE_LINE_SIZE - sizeof(std::atomic<std::uint64_t>) - sizeof(size_t)];
+		};
+
+	public:
+		class snapshot
+		{
+			friend class watched_value;
+
+			const node*  _node;
+			reader_slot* _slot;
+
+			snapshot(const node* n, reader_slot* slot) :
+				_node(n), _slot(slot)
+			{ }
+
+		public:
+			snapshot() :
+				_node(nullptr), _slot(nullptr)
+			{ }
+
+			snapshot(snapshot&& other) :
+				_node(other._node), _slot(other._slot)
+			{ other._slot = nullptr; }
+
+			snapshot& operator =(snapshot&& other)
+			{
+				if (this == &other)
+					return *this;
+				reset();
+				_node = other._node;
+				_slot = other._slot;
+				other._slot = nullptr;
+				return *this;
+			}
+
+			snapshot(const snapshot&) = delete;
+			snapshot& operator =(const snapshot&) = delete;
+
+			/// @brief Must be destroyed on the thread that has created it
+			~snapshot()
+			{ reset(); }
+
+			explicit operator bool() const
+			{ return _slot != nullptr; }
+
+			const T& operator *() const
+			{ return _node->value; }
+
+			const T* operator ->() const
+			{ return &_node->value; }
+
+			std::uint64_t version() const
+			{ return _node->version; }
+
+			void reset()
+			{
+				if (_slot && --_slot->depth == 0)
+					_slot->epoch.store(0, std::memory_order_release);
+				_slot = nullptr;
+			}
+		};
+
+	private:
+		std::atomic<node*>                                _current;
+		std::atomic<std::uint64_t>                        _epoch{1};
+		std::unique_ptr<char[]>                           _slotsStorage;
+		reader_slot*                                      _slots;
+
+		std::mutex                                        _writeMutex;
+		std::vector<node*>                                _retired;
+
+		std::mutex                                        _waitMutex;
+		std::condition_variable                           _changed;
+		std::uint64_t                                     _version;
+
+	public:
+		explicit watched_value(T initial) :
+			_current(new node(std::move(initial), 1)),
+			_slotsStorage(new char[(detail::reader_index::MaxReaderThreads + 1) * RETHREAD_CACHE_LINE_SIZE]),
+			_version(1)
+		{
+			// operator new doesn't respect extended alignment in C++11, so the slots are aligned by hand
+			uintptr_t storage = reinterpret_cast<uintptr_t>(_slotsStorage.get());
+			_slots = reinterpret_cast<reader_slot*>((storage + RETHREAD_CACHE_LINE_SIZE - 1) & ~static_cast<uintptr_t>(RETHREAD_CACHE_LINE_SIZE - 1));
+			for (size_t i = 0; i < detail::reader_index::MaxReaderThreads; ++i)
+				new (&_slots[i]) reader_slot();
+		}
+
+		watched_value(const watched_value&) = delete;
+		watched_value& operator =(const watched_value&) = delete;
+
+		/// @brief All the snapshots must be destroyed before
+		~watched_value()
+		{
+			for (size_t i = 0; i < _retired.size(); ++i)
+				delete _retired[i];
+			delete _current.load(std::memory_order_relaxed);
+		}
+
+		/// @brief Wait-free
+		snapshot read()
+		{
+			reader_slot& slot = _slots[detail::reader_index::get()];
+			if (slot.depth++ == 0)
+				slot.epoch.store(_epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+			// The slot is published before the pointer is loaded, see reclaim()
+			return snapshot(_current.load(std::memory_order_seq_cst), &slot);
+		}
+
+		std::uint64_t version()
+		{ return read().version(); }
+
+		/// @returns Version of the published value
+		std::uint64_t publish(T value)
+		{
+			std::unique_lock<std::mutex> l(_writeMutex);
+			node* old = _current.load(std::memory_order_relaxed);
+			std::uint64_t version = old->version + 1;
+			_current.store(new node(std::move(value), version), std::memory_order_seq_cst);
+			old->retired_epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+			_retired.push_back(old);
+			reclaim();
+			l.unlock();
+
+			std::unique_lock<std::mutex> wl(_waitMutex);
+			_version = version;
+			_changed.notify_all();
+			return version;
+		}
+
+		/// @brief Blocks until a version newer than the given one is published
+		/// @returns Snapshot of the newer value, or an empty one if the token was cancelled
+		snapshot wait_for_change(std::uint64_t version, const cancellation_token& token)
+		{
+			{
+				std::unique_lock<std::mutex> l(_waitMutex);
+				if (!rethread::wait(_changed, l, token, [&] { return _version > version; }))
+					return snapshot();
+			}
+			return read();
+		}
+
+	private:
+		/// @details A reader that has stored an epoch greater than the retired one has acquired it from publish(), after the pointer was replaced,
+		/// and, as the store and the load of the pointer are sequentially consistent, it can't see the retired node.
+		/// A reader whose slot is still 0 when scanned will load the pointer after the replacement for the same reason
+		void reclaim()
+		{
+			std::uint64_t min_epoch = _epoch.load(std::memory_order_seq_cst);
+			const size_t slots_count = detail::reader_index::high_water();
+			for (size_t i = 0; i < slots_count; ++i)
+			{
+				std::uint64_t epoch = _slots[i].epoch.load(std::memory_order_seq_cst);
+				if (epoch != 0 && epoch < min_epoch)
+					min_epoch = epoch;
+			}
+
+			size_t kept = 0;
+			for (size_t i = 0; i < _retired.size(); ++i)
+			{
+				if (_retired[i]->retired_epoch < min_epoch)
+					delete _retired[i];
+				else
+					_retired[kept++] = _retired[i];
+			}
+			_retired.resize(kept);
+		}
+	};
+
+}
+
+#endif
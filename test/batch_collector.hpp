@@ -0,0 +1,162 @@
+#ifndef TEST_BATCH_COLLECTOR_HPP
+#define TEST_BATCH_COLLECTOR_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/batch_collector.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+/// @brief Counts live instances
+struct collected_item
+{
+	static std::atomic<int> instances;
+
+	std::unique_ptr<int> value;
+
+	explicit collected_item(int v) : value(new int(v)) { ++instances; }
+	collected_item(collected_item&& other) noexcept : value(std::move(other.value)) { ++instances; }
+	~collected_item() { --instances; }
+};
+
+std::atomic<int> collected_item::instances{0};
+
+
+TEST(batch_collector, full_batch)
+{
+	using namespace rethread;
+
+	batch_collector<int> collector(8);
+	standalone_cancellation_token token;
+	std::thread producer([&collector, &token]
+	{
+		for (int i = 0; i < 5; ++i)
+			collector.append(i, token);
+	});
+
+	batch_collector<int>::batch b = collector.collect(5, std::chrono::hours(1), token);
+	producer.join();
+	ASSERT_EQ(b.size(), 5u);
+	for (int i = 0; i < 5; ++i)
+		EXPECT_EQ(b[i], i);
+}
+
+
+TEST(batch_collector, max_delay)
+{
+	using namespace rethread;
+
+	batch_collector<int> collector(8);
+	standalone_cancellation_token token;
+	EXPECT_TRUE(collector.try_append(1));
+	EXPECT_TRUE(collector.try_append(2));
+
+	auto start = std::chrono::steady_clock::now();
+	batch_collector<int>::batch b = collector.collect(5, std::chrono::milliseconds(20), token);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+	ASSERT_EQ(b.size(), 2u);
+	EXPECT_EQ(b[0], 1);
+	EXPECT_EQ(b[1], 2);
+
+	EXPECT_TRUE(collector.collect(5, std::chrono::milliseconds(1), token).empty());
+}
+
+
+TEST(batch_collector, cancel)
+{
+	using namespace rethread;
+
+	batch_collector<int> collector(8);
+	standalone_cancellation_token token;
+	EXPECT_TRUE(collector.try_append(1));
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+
+	batch_collector<int>::batch b = collector.collect(5, std::chrono::hours(1), token);
+	t.join();
+	ASSERT_EQ(b.size(), 1u);
+	EXPECT_EQ(b[0], 1);
+}
+
+
+TEST(batch_collector, full)
+{
+	using namespace rethread;
+
+	batch_collector<int> collector(2);
+	standalone_cancellation_token token;
+	EXPECT_TRUE(collector.try_append(1));
+	EXPECT_TRUE(collector.try_append(2));
+	EXPECT_FALSE(collector.try_append(3));
+
+	std::atomic<bool> appended{false};
+	std::thread producer([&] { appended = collector.append(3, token); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(appended);
+
+	EXPECT_EQ(collector.collect(2, std::chrono::hours(1), token).size(), 2u);
+	producer.join();
+	EXPECT_TRUE(appended);
+	EXPECT_TRUE(collector.try_append(4));
+	EXPECT_FALSE(collector.try_append(5));
+
+	std::thread canceller([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	EXPECT_FALSE(collector.append(5, token));
+	canceller.join();
+}
+
+
+TEST(batch_collector, stress)
+{
+	using namespace rethread;
+
+	static const int ProducersCount = 4;
+	static const int ItemsCount = 20000;
+	{
+		batch_collector<collected_item> collector(64);
+		standalone_cancellation_token token;
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < ProducersCount; ++p)
+			producers.emplace_back([&collector, &token, p]
+			{
+				for (int i = p; i < ItemsCount; i += ProducersCount)
+					collector.append(collected_item(i), token);
+			});
+
+		std::vector<int> seen(ItemsCount, 0);
+		int received = 0;
+		while (received < ItemsCount)
+		{
+			batch_collector<collected_item>::batch b = collector.collect(16, std::chrono::milliseconds(1), token);
+			EXPECT_LE(b.size(), collector.capacity());
+			for (collected_item& item : b)
+				++seen[*item.value];
+			received += static_cast<int>(b.size());
+		}
+		for (size_t i = 0; i < producers.size(); ++i)
+			producers[i].join();
+
+		EXPECT_EQ(received, ItemsCount);
+		EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), ItemsCount);
+
+		EXPECT_TRUE(collector.try_append(collected_item(0)));
+	}
+	EXPECT_EQ(collected_item::instances, 0);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef TEST_COROUTINE_HPP
+#define TEST_COROUTINE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <test/poll.hpp>
+
+#include <rethread_ext/coroutine.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+inline rethread::detached_task await_cancelled(const rethread::cancellation_token& token, std::atomic<int>* finished)
+{
+	co_await rethread::cancelled(token);
+	++*finished;
+}
+
+
+inline rethread::detached_task await_sleep(std::chrono::milliseconds duration, const rethread::cancellation_token& token, std::atomic<bool>* finished)
+{
+	co_await rethread::async_sleep_for(duration, token);
+	*finished = true;
+}
+
+
+inline rethread::detached_task await_poll(int fd, const rethread::cancellation_token& token, std::atomic<short>* revents, std::atomic<bool>* finished)
+{
+	*revents = co_await rethread::async_poll(fd, POLLIN, token);
+	*finished = true;
+}
+
+
+TEST(coroutine, cancelled)
+{
+	using namespace rethread;
+
+	coroutine_scheduler scheduler;
+	standalone_cancellation_token token;
+	std::atomic<int> finished{0};
+
+	spawn(scheduler, await_cancelled(token, &finished));
+	EXPECT_EQ(scheduler.run_ready(), 1u);
+	EXPECT_EQ(finished, 0);
+
+	token.cancel();
+	EXPECT_EQ(scheduler.run_ready(), 1u);
+	EXPECT_EQ(finished, 1);
+
+	spawn(scheduler, await_cancelled(token, &finished)); // doesn't suspend on a cancelled token
+	EXPECT_EQ(scheduler.run_ready(), 1u);
+	EXPECT_EQ(finished, 2);
+}
+
+
+TEST(coroutine, sleep)
+{
+	using namespace rethread;
+
+	coroutine_scheduler scheduler;
+	standalone_cancellation_token short_token, token;
+	std::atomic<bool> short_finished{false}, long_finished{false};
+
+	spawn(scheduler, await_sleep(std::chrono::milliseconds(10), short_token, &short_finished));
+	spawn(scheduler, await_sleep(std::chrono::milliseconds(60000), token, &long_finished));
+	scheduler.run_ready();
+	EXPECT_FALSE(short_finished);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	scheduler.run_ready();
+	EXPECT_TRUE(short_finished);
+	EXPECT_FALSE(long_finished);
+
+	token.cancel();
+	scheduler.run_ready();
+	EXPECT_TRUE(long_finished);
+}
+
+
+TEST(coroutine, poll)
+{
+	using namespace rethread;
+
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&pipe] { ::close(pipe[0]); ::close(pipe[1]); } );
+
+	coroutine_scheduler scheduler;
+	standalone_cancellation_token token;
+	std::atomic<short> revents{0};
+	std::atomic<bool> finished{false};
+
+	spawn(scheduler, await_poll(pipe[0], token, &revents, &finished));
+	scheduler.run_ready();
+	EXPECT_FALSE(finished);
+
+	char dummy = 0;
+	RETHREAD_CHECK(::write(pipe[1], &dummy, 1) == 1, std::runtime_error("Can't write data!"));
+	scheduler.run_ready();
+	EXPECT_TRUE(finished);
+	EXPECT_EQ(revents, POLLIN);
+	RETHREAD_CHECK(::read(pipe[0], &dummy, 1) == 1, std::runtime_error("Can't read data!"));
+
+	finished = false;
+	spawn(scheduler, await_poll(pipe[0], token, &revents, &finished));
+	scheduler.run_ready();
+	EXPECT_FALSE(finished);
+
+	token.cancel();
+	scheduler.run_ready();
+	EXPECT_TRUE(finished);
+	EXPECT_EQ(revents, 0);
+}
+
+
+TEST(coroutine, thread_pool)
+{
+	using namespace rethread;
+
+	const int Count = 1000;
+	coroutine_scheduler scheduler;
+	cancellation_token_source source;
+	std::vector<sourced_cancellation_token> tokens(Count, source.create_token());
+	std::atomic<int> finished{0};
+
+	{
+		coroutine_thread_pool pool(scheduler, 4);
+		for (int i = 0; i < Count; ++i)
+			spawn(scheduler, await_cancelled(tokens[i], &finished));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(finished, 0);
+
+		source.cancel();
+
+		auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+		while (finished != Count && std::chrono::steady_clock::now() < end_time)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(finished, Count);
+}
+
+#endif
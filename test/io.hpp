@@ -0,0 +1,282 @@
+#ifndef TEST_IO_HPP
+#define TEST_IO_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <test/poll.hpp>
+
+#include <rethread_ext/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+inline void set_nonblocking(int fd)
+{
+	int flags = ::fcntl(fd, F_GETFL);
+	RETHREAD_CHECK(flags != -1 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0, std::system_error(errno, std::system_category()));
+}
+
+
+inline int make_unix_listener(sockaddr_un& addr)
+{
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/rethread_io_test_%d.sock", (int)::getpid());
+	::unlink(addr.sun_path);
+
+	int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	RETHREAD_CHECK(listener != -1, std::system_error(errno, std::system_category()));
+	set_nonblocking(listener);
+	RETHREAD_CHECK(::bind(listener, (const sockaddr*)&addr, sizeof(addr)) == 0 && ::listen(listener, 1) == 0, std::system_error(errno, std::system_category()));
+	return listener;
+}
+
+
+/// @brief TCP listener on a free loopback port, with the accept queue as short as possible
+inline int make_loopback_listener(sockaddr_in& addr)
+{
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+	RETHREAD_CHECK(listener != -1, std::system_error(errno, std::system_category()));
+	socklen_t len = sizeof(addr);
+	RETHREAD_CHECK(::bind(listener, (const sockaddr*)&addr, sizeof(addr)) == 0 && ::listen(listener, 0) == 0 && ::getsockname(listener, (sockaddr*)&addr, &len) == 0,
+		std::system_error(errno, std::system_category()));
+	return listener;
+}
+
+
+inline int make_nonblocking_tcp_socket()
+{
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	RETHREAD_CHECK(fd != -1, std::system_error(errno, std::system_category()));
+	set_nonblocking(fd);
+	return fd;
+}
+
+
+TEST(io, read_write)
+{
+	using namespace rethread;
+
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&pipe] { ::close(pipe[0]); ::close(pipe[1]); } );
+	set_nonblocking(pipe[0]);
+	set_nonblocking(pipe[1]);
+
+	std::atomic<ssize_t> result{0};
+	char data[4] = { };
+
+	rethread::thread t([&] (const cancellation_token& token)
+	{ result = rethread::read(pipe[0], data, sizeof(data), token); });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(result, 0);
+
+	standalone_cancellation_token token;
+	EXPECT_EQ(rethread::write(pipe[1], "abc", 3, token), 3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	t.reset();
+
+	EXPECT_EQ(result, 3);
+	EXPECT_STREQ(data, "abc");
+}
+
+
+TEST(io, readv_writev)
+{
+	using namespace rethread;
+
+	int fds[2];
+	RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&fds] { ::close(fds[0]); ::close(fds[1]); } );
+	set_nonblocking(fds[0]);
+
+	standalone_cancellation_token token;
+	char out1[] = "ab", out2[] = "cd";
+	iovec out[2] = { { out1, 2 }, { out2, 2 } };
+	EXPECT_EQ(rethread::writev(fds[1], out, 2, token), 4);
+
+	char in1[3] = { }, in2[3] = { };
+	iovec in[2] = { { in1, 2 }, { in2, 2 } };
+	EXPECT_EQ(rethread::readv(fds[0], in, 2, token), 4);
+	EXPECT_STREQ(in1, "ab");
+	EXPECT_STREQ(in2, "cd");
+}
+
+
+TEST(io, read_cancel)
+{
+	using namespace rethread;
+
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&pipe] { ::close(pipe[0]); ::close(pipe[1]); } );
+	set_nonblocking(pipe[0]);
+
+	std::atomic<bool> finished{false};
+	ssize_t result = 0;
+	int error = 0;
+
+	rethread::thread t([&] (const cancellation_token& token)
+	{
+		char dummy = 0;
+		result = rethread::read(pipe[0], &dummy, 1, token);
+		error = errno;
+		finished = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(finished);
+
+	t.reset();
+
+	EXPECT_TRUE(finished);
+	EXPECT_EQ(result, -1);
+	EXPECT_EQ(error, ECANCELED);
+}
+
+
+TEST(io, accept_connect)
+{
+	using namespace rethread;
+
+	sockaddr_un addr;
+	int listener = make_unix_listener(addr);
+	auto scope_guard = scope_exit([&] { ::close(listener); ::unlink(addr.sun_path); } );
+
+	std::atomic<int> accepted{-1};
+	std::atomic<bool> finished{false};
+	rethread::thread t([&] (const cancellation_token& token)
+	{
+		accepted = rethread::accept(listener, nullptr, nullptr, token);
+		finished = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(finished);
+
+	int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	RETHREAD_CHECK(client != -1, std::system_error(errno, std::system_category()));
+	auto client_guard = scope_exit([&client] { ::close(client); } );
+	set_nonblocking(client);
+
+	standalone_cancellation_token token;
+	EXPECT_EQ(rethread::connect(client, (const sockaddr*)&addr, sizeof(addr), token), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	t.reset();
+	EXPECT_TRUE(finished);
+	EXPECT_NE(accepted, -1);
+	if (accepted != -1)
+		::close(accepted);
+}
+
+
+#if defined(__linux__)
+// Linux drops the SYNs to a listener with a full accept queue, so a connection attempt after the queue is filled stays in progress
+TEST(io, connect_cancel)
+{
+	using namespace rethread;
+
+	sockaddr_in addr;
+	int listener = make_loopback_listener(addr);
+	std::vector<int> clients;
+	auto scope_guard = scope_exit([&] { ::close(listener); for (size_t i = 0; i < clients.size(); ++i) ::close(clients[i]); } );
+
+	int pending = -1;
+	for (int i = 0; i < 16 && pending == -1; ++i)
+	{
+		clients.push_back(make_nonblocking_tcp_socket());
+		ASSERT_EQ(::connect(clients.back(), (const sockaddr*)&addr, sizeof(addr)), -1);
+		ASSERT_EQ(errno, EINPROGRESS);
+		pollfd fd = { clients.back(), POLLOUT, 0 };
+		if (::poll(&fd, 1, 100) == 0)
+			pending = clients.back();
+	}
+	ASSERT_NE(pending, -1);
+
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	auto start = std::chrono::steady_clock::now();
+	int client = make_nonblocking_tcp_socket();
+	clients.push_back(client);
+	EXPECT_EQ(rethread::connect(client, (const sockaddr*)&addr, sizeof(addr), token), -1);
+	EXPECT_EQ(errno, ECANCELED);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+	t.join();
+}
+
+
+// A connection to a closed loopback port is refused asynchronously, the error comes from SO_ERROR
+TEST(io, connect_refused)
+{
+	using namespace rethread;
+
+	sockaddr_in addr;
+	::close(make_loopback_listener(addr));
+
+	int probe = make_nonblocking_tcp_socket();
+	int client = make_nonblocking_tcp_socket();
+	auto client_guard = scope_exit([&] { ::close(probe); ::close(client); } );
+
+	// The refusal doesn't come from connect() itself
+	ASSERT_EQ(::connect(probe, (const sockaddr*)&addr, sizeof(addr)), -1);
+	ASSERT_EQ(errno, EINPROGRESS);
+
+	standalone_cancellation_token token;
+	EXPECT_EQ(rethread::connect(client, (const sockaddr*)&addr, sizeof(addr), token), -1);
+	EXPECT_EQ(errno, ECONNREFUSED);
+}
+#endif
+
+
+TEST(io, accept_cancel)
+{
+	using namespace rethread;
+
+	sockaddr_un addr;
+	int listener = make_unix_listener(addr);
+	auto scope_guard = scope_exit([&] { ::close(listener); ::unlink(addr.sun_path); } );
+
+	std::atomic<bool> finished{false};
+	int result = 0;
+	int error = 0;
+	rethread::thread t([&] (const cancellation_token& token)
+	{
+		result = rethread::accept(listener, nullptr, nullptr, token);
+		error = errno;
+		finished = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(finished);
+
+	t.reset();
+	EXPECT_TRUE(finished);
+	EXPECT_EQ(result, -1);
+	EXPECT_EQ(error, ECANCELED);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef TEST_PIPELINE_HPP
+#define TEST_PIPELINE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/pipeline.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+
+TEST(pipeline, drain_on_close)
+{
+	using namespace rethread;
+
+	pipeline_options options;
+	options.queue_capacity = 8;
+	options.batch_size = 3;
+
+	std::atomic<long> sum{0};
+	std::atomic<int> count{0};
+	auto p = make_pipeline<std::string>(options)
+		.stage<int>([] (std::string&& s) { return std::stoi(s); }, 2)
+		.stage<long>([] (int&& i) { return 2L * i; }, 3)
+		.sink([&] (long&& l) { sum += l; ++count; });
+
+	standalone_cancellation_token token;
+	const int Count = 1000;
+	for (int i = 1; i <= Count; ++i)
+		EXPECT_TRUE(p.push(std::to_string(i), token));
+	p.close();
+	p.wait();
+
+	EXPECT_EQ(count, Count);
+	EXPECT_EQ(sum, (long)Count * (Count + 1));
+	EXPECT_FALSE(p.push(std::string("1"), token));
+}
+
+
+TEST(pipeline, drain_on_cancel)
+{
+	using namespace rethread;
+
+	pipeline_options options;
+	options.cancel_policy = pipeline_cancel_policy::drain;
+
+	std::atomic<int> count{0};
+	auto p = make_pipeline<int>(options)
+		.stage<int>([] (int&& i) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); return i; })
+		.sink([&] (int&&) { ++count; });
+
+	standalone_cancellation_token token;
+	std::vector<int> batch(20, 0);
+	EXPECT_TRUE(p.push(batch, token));
+	EXPECT_TRUE(batch.empty());
+
+	p.cancel();
+	p.wait();
+	EXPECT_EQ(count, 20);
+}
+
+
+TEST(pipeline, drop_on_cancel)
+{
+	using namespace rethread;
+
+	pipeline_options options;
+	options.queue_capacity = 4;
+	options.batch_size = 1;
+
+	std::atomic<int> count{0};
+	auto p = make_pipeline<int>(options)
+		.sink([&] (int&&) { ++count; std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+
+	std::atomic<bool> producer_finished{false};
+	rethread::thread producer([&] (const cancellation_token& t)
+	{
+		for (int i = 0; p.push(i, t); ++i)
+			;
+		producer_finished = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(producer_finished);
+
+	p.cancel();
+	p.wait();
+
+	auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+	while (!producer_finished && std::chrono::steady_clock::now() < end_time)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	EXPECT_TRUE(producer_finished);
+	EXPECT_LE(count, 2);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef TEST_PROCESS_HPP
+#define TEST_PROCESS_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <test/poll.hpp>
+
+#include <rethread_ext/process.hpp>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+/// @brief Forks a child that runs the function and exits with its result. Only async-signal-safe calls are allowed in it
+template <typename Func_>
+pid_t fork_child(const Func_& func)
+{
+	pid_t pid = ::fork();
+	RETHREAD_CHECK(pid != -1, std::system_error(errno, std::system_category()));
+	if (pid == 0)
+		::_exit(func());
+	return pid;
+}
+
+
+/// @brief Blocks the signal in the calling thread for the lifetime of the object, threads started meanwhile inherit the mask
+class signal_blocker
+{
+	sigset_t _signals;
+	sigset_t _old;
+
+public:
+	explicit signal_blocker(int signo)
+	{
+		sigemptyset(&_signals);
+		sigaddset(&_signals, signo);
+		RETHREAD_CHECK(::pthread_sigmask(SIG_BLOCK, &_signals, &_old) == 0, std::runtime_error("pthread_sigmask failed"));
+	}
+
+	signal_blocker(const signal_blocker&) = delete;
+	signal_blocker& operator =(const signal_blocker&) = delete;
+
+	~signal_blocker()
+	{ ::pthread_sigmask(SIG_SETMASK, &_old, nullptr); }
+
+	const sigset_t& signals() const
+	{ return _signals; }
+};
+
+
+TEST(process, wait_child)
+{
+	using namespace rethread;
+
+	pid_t pid = fork_child([] { ::usleep(20000); return 3; });
+
+	standalone_cancellation_token token;
+	int status = wait_child(pid, token);
+	ASSERT_NE(status, -1);
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 3);
+
+	errno = 0;
+	EXPECT_EQ(::waitpid(pid, nullptr, WNOHANG), -1);
+	EXPECT_EQ(errno, ECHILD);
+}
+
+
+TEST(process, wait_child_cancel)
+{
+	using namespace rethread;
+
+	pid_t pid = fork_child([] { ::sleep(30); return 0; });
+	auto child_guard = scope_exit([pid] { ::kill(pid, SIGKILL); ::waitpid(pid, nullptr, 0); } );
+
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	auto thread_guard = scope_exit([&t] { t.join(); } );
+
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(wait_child(pid, token), -1);
+	EXPECT_EQ(errno, ECANCELED);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+	EXPECT_EQ(::waitpid(pid, nullptr, WNOHANG), 0);
+}
+
+
+TEST(process, wait_signal)
+{
+	using namespace rethread;
+
+	signal_blocker blocker(SIGUSR1);
+	pid_t parent = ::getpid();
+	pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+	// Thread-directed, so that no other thread of the test runner can take the signal
+	pid_t pid = fork_child([parent, tid] { ::usleep(20000); return (int)::syscall(SYS_tgkill, parent, tid, SIGUSR1); });
+	auto child_guard = scope_exit([pid] { ::waitpid(pid, nullptr, 0); } );
+
+	standalone_cancellation_token token;
+	signalfd_siginfo info;
+	EXPECT_EQ(wait_signal(blocker.signals(), token, &info), SIGUSR1);
+	EXPECT_EQ((pid_t)info.ssi_pid, pid);
+}
+
+
+TEST(process, wait_signal_cancel)
+{
+	using namespace rethread;
+
+	signal_blocker blocker(SIGUSR2);
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	auto thread_guard = scope_exit([&t] { t.join(); } );
+
+	EXPECT_EQ(wait_signal(blocker.signals(), token), -1);
+	EXPECT_EQ(errno, ECANCELED);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef TEST_RESOURCE_POOL_HPP
+#define TEST_RESOURCE_POOL_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/resource_pool.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST(resource_pool, acquire_release)
+{
+	using namespace rethread;
+
+	resource_pool<int> pool(std::vector<int>{ 1, 2 });
+	standalone_cancellation_token token;
+
+	resource_pool<int>::handle a = pool.acquire(token);
+	resource_pool<int>::handle b = pool.acquire(token);
+	ASSERT_TRUE(a && b);
+	EXPECT_EQ(*a + *b, 3);
+	EXPECT_FALSE(pool.try_acquire());
+
+	b.reset();
+	resource_pool<int>::handle c = pool.try_acquire();
+	ASSERT_TRUE(c);
+	EXPECT_NE(*c, *a);
+}
+
+
+TEST(resource_pool, fifo_hand_off)
+{
+	using namespace rethread;
+
+	resource_pool<int> pool(std::vector<int>{ 0 });
+	standalone_cancellation_token token;
+	resource_pool<int>::handle held = pool.acquire(token);
+
+	const size_t Count = 4;
+	std::vector<size_t> order;
+	std::mutex m;
+	std::vector<std::thread> waiters;
+	for (size_t i = 0; i < Count; ++i)
+	{
+		waiters.emplace_back([&, i]
+		{
+			standalone_cancellation_token t;
+			resource_pool<int>::handle h = pool.acquire(t);
+			EXPECT_TRUE(h);
+			std::unique_lock<std::mutex> l(m);
+			order.push_back(i);
+		});
+		while (pool.waiters_count() != i + 1)
+			std::this_thread::yield();
+	}
+
+	held.reset();
+	for (size_t i = 0; i < Count; ++i)
+		waiters[i].join();
+
+	ASSERT_EQ(order.size(), Count);
+	for (size_t i = 0; i < Count; ++i)
+		EXPECT_EQ(order[i], i);
+}
+
+
+TEST(resource_pool, cancel)
+{
+	using namespace rethread;
+
+	resource_pool<int> pool(std::vector<int>{ 0 });
+	standalone_cancellation_token token;
+	resource_pool<int>::handle held = pool.acquire(token);
+
+	standalone_cancellation_token waiter_token;
+	std::thread t([&] { EXPECT_FALSE(pool.acquire(waiter_token)); });
+	while (pool.waiters_count() != 1)
+		std::this_thread::yield();
+	waiter_token.cancel();
+	t.join();
+
+	EXPECT_EQ(pool.waiters_count(), 0u);
+	held.reset();
+	EXPECT_TRUE(pool.try_acquire());
+}
+
+
+TEST(resource_pool, stress)
+{
+	using namespace rethread;
+
+	const size_t Size = 3;
+	std::vector<std::atomic<int>*> users;
+	std::vector<std::unique_ptr<std::atomic<int>>> storage;
+	for (size_t i = 0; i < Size; ++i)
+	{
+		storage.emplace_back(new std::atomic<int>(0));
+		users.push_back(storage.back().get());
+	}
+	resource_pool<std::atomic<int>*> pool(users);
+
+	std::vector<std::thread> threads_list;
+	for (int i = 0; i < 8; ++i)
+		threads_list.emplace_back([&]
+		{
+			standalone_cancellation_token token;
+			for (int j = 0; j < 2000; ++j)
+			{
+				resource_pool<std::atomic<int>*>::handle h = pool.acquire(token);
+				ASSERT_TRUE(h);
+				EXPECT_EQ((*h)->fetch_add(1), 0);
+				std::this_thread::yield();
+				(*h)->fetch_sub(1);
+			}
+		});
+	for (size_t i = 0; i < threads_list.size(); ++i)
+		threads_list[i].join();
+
+	EXPECT_EQ(pool.waiters_count(), 0u);
+	std::vector<resource_pool<std::atomic<int>*>::handle> handles;
+	for (size_t i = 0; i < Size; ++i)
+	{
+		handles.push_back(pool.try_acquire());
+		EXPECT_TRUE(handles.back());
+	}
+	EXPECT_FALSE(pool.try_acquire());
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef TEST_SHARED_CANCELLATION_TOKEN_HPP
+#define TEST_SHARED_CANCELLATION_TOKEN_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <test/poll.hpp>
+#include <test/process.hpp>
+
+#include <rethread/condition_variable.hpp>
+#include <rethread/poll.hpp>
+#include <rethread_ext/shared_cancellation_token.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+// The children only use shared_cancellation_state, which is async-signal-safe, the tokens with their watcher threads stay in the parent
+
+namespace
+{
+	pid_t fork_cancelling_child(rethread::shared_cancellation_state& state)
+	{ return fork_child([&state] { ::usleep(20000); state.cancel(); return 0; }); }
+
+
+	int wait_exit_code(pid_t pid)
+	{
+		int status = 0;
+		RETHREAD_CHECK(::waitpid(pid, &status, 0) == pid, std::system_error(errno, std::system_category()));
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
+
+
+	bool wait_cancelled(const rethread::cancellation_token& token)
+	{
+		auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (token && std::chrono::steady_clock::now() < end_time)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return token.is_cancelled();
+	}
+}
+
+
+TEST(shared_cancellation_token, sleep_for)
+{
+	using namespace rethread;
+
+	shared_cancellation_segment segment(1);
+	shared_cancellation_token token(segment[0]);
+	pid_t pid = fork_cancelling_child(segment[0]);
+
+	auto start = std::chrono::steady_clock::now();
+	token.sleep_for(std::chrono::seconds(10));
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+	EXPECT_TRUE(segment[0].is_cancelled());
+	EXPECT_TRUE(wait_cancelled(token));
+	EXPECT_EQ(wait_exit_code(pid), 0);
+
+	token.reset();
+	start = std::chrono::steady_clock::now();
+	token.sleep_for(std::chrono::milliseconds(20));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+}
+
+
+TEST(shared_cancellation_token, wait)
+{
+	using namespace rethread;
+
+	shared_cancellation_segment segment(1);
+	shared_cancellation_token token(segment[0]);
+	pid_t pid = fork_cancelling_child(segment[0]);
+
+	std::mutex m;
+	std::condition_variable cv;
+	std::unique_lock<std::mutex> l(m);
+	EXPECT_FALSE(rethread::wait(cv, l, token, [] { return false; }));
+	EXPECT_TRUE(token.is_cancelled());
+	EXPECT_EQ(wait_exit_code(pid), 0);
+}
+
+
+TEST(shared_cancellation_token, poll)
+{
+	using namespace rethread;
+
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&pipe] { ::close(pipe[0]); ::close(pipe[1]); });
+
+	shared_cancellation_segment segment(1);
+	shared_cancellation_token token(segment[0]);
+	pid_t pid = fork_cancelling_child(segment[0]);
+
+	EXPECT_EQ(rethread::poll(pipe[0], POLLIN, token), 0);
+	EXPECT_TRUE(token.is_cancelled());
+	EXPECT_EQ(wait_exit_code(pid), 0);
+}
+
+
+TEST(shared_cancellation_token, cancel_child)
+{
+	using namespace rethread;
+
+	shared_cancellation_segment segment(2);
+	shared_cancellation_state& state = segment[1];
+	pid_t waiting = fork_child([&state] { return state.wait_for(std::chrono::seconds(10)) ? 0 : 1; });
+	pid_t timing_out = fork_child([&state] { return state.wait_for(std::chrono::milliseconds(1)) ? 0 : 1; });
+	EXPECT_EQ(wait_exit_code(timing_out), 1);
+
+	shared_cancellation_token token(state);
+	EXPECT_FALSE(token.is_cancelled());
+	token.cancel();
+	EXPECT_TRUE(token.is_cancelled());
+	EXPECT_EQ(wait_exit_code(waiting), 0);
+	EXPECT_FALSE(segment[0].is_cancelled());
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef TEST_SPLICE_HPP
+#define TEST_SPLICE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <test/io.hpp>
+
+#include <rethread_ext/splice.hpp>
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+inline std::string make_pattern(size_t size)
+{
+	std::string result(size, '\0');
+	for (size_t i = 0; i < size; ++i)
+		result[i] = static_cast<char>('a' + i % 23);
+	return result;
+}
+
+
+/// @brief Reads everything until EOF on its own thread
+class fd_collector
+{
+	std::string _data;
+	std::thread _thread;
+
+public:
+	explicit fd_collector(int fd) :
+		_thread([this, fd]
+		{
+			char buf[65536];
+			ssize_t result;
+			while ((result = ::read(fd, buf, sizeof(buf))) > 0 || (result == -1 && errno == EINTR))
+				if (result > 0)
+					_data.append(buf, static_cast<size_t>(result));
+		})
+	{ }
+
+	const std::string& join()
+	{
+		_thread.join();
+		return _data;
+	}
+};
+
+
+TEST(splice, socket_to_pipe)
+{
+	using namespace rethread;
+
+	int sockets[2];
+	int pipe[2];
+	RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0 && ::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&] { ::close(sockets[0]); ::close(sockets[1]); ::close(pipe[0]); } );
+	set_nonblocking(sockets[1]);
+	set_nonblocking(pipe[1]);
+
+	const std::string data = make_pattern(3 << 20);
+	std::thread writer([&] { EXPECT_EQ(::write(sockets[0], data.data(), data.size()), (ssize_t)data.size()); ::shutdown(sockets[0], SHUT_WR); });
+	fd_collector collector(pipe[0]);
+
+	standalone_cancellation_token token;
+	size_t stranded = 1;
+	EXPECT_EQ(rethread::splice(sockets[1], pipe[1], data.size() + 1, token, stranded), (ssize_t)data.size());
+	EXPECT_EQ(stranded, 0u);
+	writer.join();
+	::close(pipe[1]);
+	EXPECT_TRUE(collector.join() == data);
+}
+
+
+TEST(splice, cancel)
+{
+	using namespace rethread;
+
+	int sockets[2];
+	int pipe[2];
+	RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0 && ::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&] { ::close(sockets[0]); ::close(sockets[1]); ::close(pipe[0]); ::close(pipe[1]); } );
+	set_nonblocking(sockets[1]);
+	set_nonblocking(pipe[1]);
+
+	ASSERT_EQ(::write(sockets[0], "0123456789", 10), 10);
+
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	size_t stranded = 1;
+	EXPECT_EQ(rethread::splice(sockets[1], pipe[1], 1000, token, stranded), 10);
+	EXPECT_EQ(stranded, 0u);
+	t.join();
+
+	EXPECT_EQ(rethread::splice(sockets[1], pipe[1], 1000, token, stranded), -1);
+	EXPECT_EQ(errno, ECANCELED);
+	EXPECT_EQ(stranded, 0u);
+
+	char buf[16];
+	ASSERT_EQ(::read(pipe[0], buf, sizeof(buf)), 10);
+	EXPECT_EQ(std::string(buf, 10), "0123456789");
+}
+
+
+TEST(splice, cancel_stranded)
+{
+	using namespace rethread;
+
+	int sockets[2];
+	int pipe[2];
+	RETHREAD_CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0 && ::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&] { ::close(sockets[0]); ::close(sockets[1]); ::close(pipe[0]); ::close(pipe[1]); } );
+	set_nonblocking(sockets[1]);
+	set_nonblocking(pipe[1]);
+
+	// out_fd is full, so the bytes read from the socket stay in the intermediate pipe until the cancellation
+	const std::string filler(65536, 'x');
+	while (::write(pipe[1], filler.data(), filler.size()) > 0)
+		;
+	ASSERT_EQ(errno, EAGAIN);
+	ASSERT_EQ(::write(sockets[0], "0123456789", 10), 10);
+
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	size_t stranded = 0;
+	EXPECT_EQ(rethread::splice(sockets[1], pipe[1], 1000, token, stranded), -1);
+	EXPECT_EQ(errno, ECANCELED);
+	EXPECT_EQ(stranded, 10u);
+	t.join();
+}
+
+
+TEST(splice, sendfile)
+{
+	using namespace rethread;
+
+	char path[] = "/tmp/rethread_splice_test_XXXXXX";
+	int file = ::mkstemp(path);
+	RETHREAD_CHECK(file != -1, std::system_error(errno, std::system_category()));
+	::unlink(path);
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&] { ::close(file); ::close(pipe[0]); } );
+	set_nonblocking(pipe[1]);
+
+	const std::string data = make_pattern(1 << 20);
+	ASSERT_EQ(::write(file, data.data(), data.size()), (ssize_t)data.size());
+
+	fd_collector collector(pipe[0]);
+	standalone_cancellation_token token;
+	off_t offset = 100;
+	EXPECT_EQ(rethread::sendfile(pipe[1], file, &offset, data.size(), token), (ssize_t)data.size() - 100);
+	EXPECT_EQ(offset, (off_t)data.size());
+	::close(pipe[1]);
+	EXPECT_TRUE(collector.join() == data.substr(100));
+}
+
+
+TEST(splice, sendfile_cancel)
+{
+	using namespace rethread;
+
+	char path[] = "/tmp/rethread_splice_test_XXXXXX";
+	int file = ::mkstemp(path);
+	RETHREAD_CHECK(file != -1, std::system_error(errno, std::system_category()));
+	::unlink(path);
+	int pipe[2];
+	RETHREAD_CHECK(::pipe(pipe) == 0, std::system_error(errno, std::system_category()));
+	auto scope_guard = scope_exit([&] { ::close(file); ::close(pipe[0]); ::close(pipe[1]); } );
+	set_nonblocking(pipe[1]);
+
+	const std::string data = make_pattern(1 << 20);
+	ASSERT_EQ(::write(file, data.data(), data.size()), (ssize_t)data.size());
+
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	off_t offset = 0;
+	ssize_t result = rethread::sendfile(pipe[1], file, &offset, data.size(), token);
+	t.join();
+
+	EXPECT_GT(result, 0);
+	EXPECT_LT(result, (ssize_t)data.size());
+	EXPECT_EQ(offset, (off_t)result);
+}
+
+#endif
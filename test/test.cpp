@@ -9,13 +9,35 @@
 
 #if defined(RETHREAD_HAS_POLL)
 #include <test/poll.hpp>
+#include <test/io.hpp>
 #endif
 
+#if defined(RETHREAD_HAS_POLL) && defined(__linux__)
+#include <test/process.hpp>
+#include <test/splice.hpp>
+#include <test/shared_cancellation_token.hpp>
+#endif
+
+#if defined(RETHREAD_HAS_POLL) && defined(RETHREAD_HAS_COROUTINES)
+#include <test/coroutine.hpp>
+#endif
+
+#include <test/pipeline.hpp>
+#include <test/trace.hpp>
+#include <test/resource_pool.hpp>
+#include <test/thread_cache.hpp>
+#include <test/watched_value.hpp>
+#include <test/batch_collector.hpp>
+
 #include <rethread/cancellation_token.hpp>
 #include <rethread/condition_variable.hpp>
 #include <rethread/thread.hpp>
 #include <rethread/cancellation_token.hpp>
 
+#include <rethread_ext/cancellation_dispatcher.hpp>
+#include <rethread_ext/compact_cancellation_token.hpp>
+#include <rethread_ext/timed_wait.hpp>
+
 #include <gmock/gmock.h>
 
 #include <atomic>
@@ -290,6 +312,112 @@ TEST_F(cancellation_token_fixture, cv_predicate_nowait)
 }
 
 
+TEST_F(cancellation_token_fixture, cv_timed_predicate_test)
+{
+	bool flag = false;
+	wait_result result = wait_result::timeout;
+	rethread::thread t([this, &flag, &result] (const cancellation_token&)
+	{
+	   std::unique_lock<std::mutex> l(_mutex);
+	   _started.set();
+	   result = wait_for(_cv, l, std::chrono::seconds(30), _token, [&flag] { return flag; });
+	   _finished.set();
+	});
+
+	EXPECT_TRUE(_started.is_set(std::chrono::seconds(3)));
+
+	for (int i = 0; i < 10; ++i)
+	{
+		std::unique_lock<std::mutex> l(_mutex);
+		_cv.notify_all();
+	}
+
+	EXPECT_FALSE(_finished.is_set());
+
+	std::unique_lock<std::mutex> l(_mutex);
+	flag = true;
+	_cv.notify_all();
+	l.unlock();
+
+	EXPECT_TRUE(_finished.is_set(std::chrono::seconds(3)));
+
+	l.lock();
+	EXPECT_EQ(result, wait_result::ready);
+}
+
+
+TEST_F(cancellation_token_fixture, cv_timed_predicate_cancel)
+{
+	bool flag = false;
+	wait_result result = wait_result::ready;
+	rethread::thread t([this, &flag, &result] (const cancellation_token&)
+	{
+	   std::unique_lock<std::mutex> l(_mutex);
+	   _started.set();
+	   result = wait_until(_cv, l, std::chrono::steady_clock::now() + std::chrono::seconds(30), _token, [&flag] { return flag; });
+	   _finished.set();
+	});
+
+	EXPECT_TRUE(_started.is_set(std::chrono::seconds(3)));
+
+	for (int i = 0; i < 10; ++i)
+	{
+		std::unique_lock<std::mutex> l(_mutex);
+		_cv.notify_all();
+	}
+
+	EXPECT_FALSE(_finished.is_set());
+
+	_token.cancel();
+
+	EXPECT_TRUE(_finished.is_set(std::chrono::seconds(3)));
+
+	std::unique_lock<std::mutex> l(_mutex);
+	EXPECT_EQ(result, wait_result::cancelled);
+}
+
+
+TEST_F(cancellation_token_fixture, cv_timed_predicate_timeout)
+{
+	bool flag = false;
+	std::unique_lock<std::mutex> l(_mutex);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(wait_for(_cv, l, std::chrono::milliseconds(50), _token, [&flag] { return flag; }), wait_result::timeout);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+	EXPECT_TRUE(l.owns_lock());
+
+	flag = true;
+	_token.cancel();
+	EXPECT_EQ(wait_for(_cv, l, std::chrono::milliseconds(50), _token, [&flag] { return flag; }), wait_result::ready);
+}
+
+
+TEST_F(cancellation_token_fixture, cv_timed_test)
+{
+	wait_result result = wait_result::timeout;
+	rethread::thread t([this, &result] (const cancellation_token&)
+	{
+	   std::unique_lock<std::mutex> l(_mutex);
+	   _started.set();
+	   result = wait_for(_cv, l, std::chrono::seconds(30), _token);
+	   _finished.set();
+	});
+
+	EXPECT_TRUE(_started.is_set(std::chrono::seconds(3)));
+
+	std::unique_lock<std::mutex> l(_mutex);
+	_cv.notify_all();
+	l.unlock();
+
+	EXPECT_TRUE(_finished.is_set(std::chrono::seconds(3)));
+
+	l.lock();
+	EXPECT_EQ(result, wait_result::ready);
+	_token.cancel();
+	EXPECT_EQ(wait_for(_cv, l, std::chrono::seconds(30), _token), wait_result::cancelled);
+}
+
+
 TEST_F(cancellation_token_fixture, sleep_test)
 {
 	rethread::thread t([this] (const cancellation_token&)
@@ -425,6 +553,91 @@ TEST(cancellation_token, stress_test_sourced)
 }
 
 
+TEST(cancellation_token, stress_test_compact)
+{
+	const std::chrono::nanoseconds MaxDelay{10000};
+	const std::chrono::nanoseconds DelayStep{10};
+	for (std::chrono::nanoseconds delay{0}; delay < MaxDelay; delay += DelayStep)
+	{
+		compact_cancellation_token token;
+		do_stress_test(delay, MaxDelay - delay, token, [&token] { token.cancel(); });
+	}
+}
+
+
+TEST(compact_cancellation_token, handler_cancel_test)
+{
+	compact_cancellation_token token;
+	cancellation_handler_mock handler;
+
+	{
+		InSequence seq;
+
+		EXPECT_CALL(handler, cancel()).Times(1);
+		EXPECT_CALL(handler, reset()).Times(1);
+	}
+
+	cancellation_guard guard(token, handler);
+	EXPECT_FALSE(guard.is_cancelled());
+	token.cancel();
+	EXPECT_TRUE(token.is_cancelled());
+}
+
+
+TEST(compact_cancellation_token, reset)
+{
+	compact_cancellation_token token;
+	token.cancel();
+	EXPECT_FALSE(token);
+
+	token.reset();
+	EXPECT_TRUE(token);
+
+	cancellation_handler_dummy handler;
+	{
+		cancellation_guard guard(token, handler);
+		EXPECT_FALSE(guard.is_cancelled());
+	}
+	EXPECT_FALSE(handler._cancelled);
+	EXPECT_FALSE(handler._reset);
+}
+
+
+TEST(compact_cancellation_token, sleep_and_wait)
+{
+	std::mutex                 m;
+	std::condition_variable    cv;
+	compact_cancellation_token sleep_token;
+	compact_cancellation_token wait_token;
+	testing_flag               slept;
+	testing_flag               waited;
+
+	rethread::thread t1([&] (const cancellation_token&)
+	{
+		rethread::this_thread::sleep_for(std::chrono::minutes(1), sleep_token);
+		slept.set();
+	});
+
+	rethread::thread t2([&] (const cancellation_token&)
+	{
+		std::unique_lock<std::mutex> l(m);
+		while (wait_token)
+			wait(cv, l, wait_token);
+		waited.set();
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(slept.is_set());
+	EXPECT_FALSE(waited.is_set());
+
+	sleep_token.cancel();
+	wait_token.cancel();
+
+	EXPECT_TRUE(slept.is_set(std::chrono::seconds(3)));
+	EXPECT_TRUE(waited.is_set(std::chrono::seconds(3)));
+}
+
+
 TEST(cancellation_token, dummy_copy_test)
 {
 	dummy_cancellation_token token;
@@ -487,6 +700,92 @@ TEST(chain_cancellation_tokens, source)
 }
 
 
+struct thread_recording_handler : cancellation_handler
+{
+	std::atomic<bool> _cancelled{false};
+	std::thread::id   _thread_id;
+
+	void cancel() override
+	{
+		_thread_id = std::this_thread::get_id();
+		_cancelled = true;
+	}
+};
+
+
+TEST(async_canceller, source)
+{
+	cancellation_dispatcher dispatcher;
+	cancellation_token_source source;
+	sourced_cancellation_token token(source.create_token());
+	thread_recording_handler handler;
+
+	{
+		cancellation_guard guard(token, handler);
+		async_canceller<cancellation_token_source> canceller(source, dispatcher);
+
+		EXPECT_FALSE(canceller.is_cancel_requested());
+		canceller.cancel();
+		EXPECT_TRUE(canceller.is_cancel_requested());
+		canceller.wait();
+
+		EXPECT_TRUE(handler._cancelled);
+		EXPECT_NE(handler._thread_id, std::this_thread::get_id());
+		EXPECT_FALSE(token);
+	}
+}
+
+
+TEST_F(cancellation_token_fixture, async_canceller_standalone)
+{
+	cancellation_dispatcher dispatcher;
+	rethread::thread t([this] (const cancellation_token&)
+	{
+		std::unique_lock<std::mutex> l(_mutex);
+		while (_token)
+		{
+			_started.set();
+			wait(_cv, l, _token);
+		}
+		_finished.set();
+	});
+
+	EXPECT_TRUE(_started.is_set(std::chrono::seconds(3)));
+
+	async_canceller<standalone_cancellation_token> canceller(_token, dispatcher);
+	canceller.cancel();
+	canceller.cancel(); // second request is a no-op
+
+	EXPECT_TRUE(_finished.is_set(std::chrono::seconds(3)));
+}
+
+
+TEST(async_canceller, compact)
+{
+	cancellation_dispatcher dispatcher;
+	compact_cancellation_token token;
+	async_canceller<compact_cancellation_token> canceller(token, dispatcher);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		thread_recording_handler handler;
+		{
+			cancellation_guard guard(token, handler);
+			canceller.cancel();
+			EXPECT_FALSE(token); // cancelled in place, before the dispatcher runs the handler
+			canceller.wait();
+
+			EXPECT_TRUE(handler._cancelled);
+			EXPECT_NE(handler._thread_id, std::this_thread::get_id());
+		}
+
+		canceller.reset();
+		EXPECT_FALSE(canceller.is_cancel_requested());
+		token.reset();
+	}
+}
+
+
 int main(int argc, char** argv)
 {
 	// The following line must be executed to initialize Google Mock
@@ -0,0 +1,93 @@
+#ifndef TEST_THREAD_CACHE_HPP
+#define TEST_THREAD_CACHE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/thread_cache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST(cached_thread, reuses_os_thread)
+{
+	using namespace rethread;
+
+	thread_cache cache(1);
+	std::thread::id first_id;
+	std::thread::id second_id;
+	{
+		cached_thread t(cache, [&first_id] (const cancellation_token&) { first_id = std::this_thread::get_id(); });
+		EXPECT_TRUE(t.joinable());
+	}
+	EXPECT_EQ(cache.idle_count(), 1u);
+
+	bool fresh_token = false;
+	std::atomic<bool> started{false};
+	cached_thread t(cache, [&] (int, const cancellation_token& token) { second_id = std::this_thread::get_id(); fresh_token = !token.is_cancelled(); started = true; }, 42);
+	EXPECT_EQ(cache.idle_count(), 0u);
+	while (!started)
+		std::this_thread::yield();
+	t.reset();
+	EXPECT_TRUE(fresh_token);
+	EXPECT_FALSE(t.joinable());
+
+	EXPECT_EQ(first_id, second_id);
+	EXPECT_NE(first_id, std::this_thread::get_id());
+}
+
+
+TEST(cached_thread, reset_cancels)
+{
+	using namespace rethread;
+
+	thread_cache cache(1);
+	std::atomic<int> finished{0};
+	for (int i = 0; i < 3; ++i)
+	{
+		cached_thread t(cache, [&finished] (const cancellation_token& token)
+		{
+			while (token)
+				token.sleep_for(std::chrono::hours(1));
+			++finished;
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		EXPECT_EQ(finished, i);
+		t.reset();
+		EXPECT_EQ(finished, i + 1);
+	}
+}
+
+
+TEST(cached_thread, max_idle)
+{
+	using namespace rethread;
+
+	thread_cache cache(2);
+	{
+		std::vector<cached_thread> threads_list;
+		for (int i = 0; i < 4; ++i)
+			threads_list.push_back(cached_thread(cache, [] (const cancellation_token&) { }));
+
+		cached_thread moved(std::move(threads_list.back()));
+		EXPECT_FALSE(threads_list.back().joinable());
+		EXPECT_TRUE(moved.joinable());
+	}
+	EXPECT_EQ(cache.idle_count(), 2u);
+
+	cache.clear();
+	EXPECT_EQ(cache.idle_count(), 0u);
+}
+
+#endif
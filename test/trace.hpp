@@ -0,0 +1,124 @@
+#ifndef TEST_TRACE_HPP
+#define TEST_TRACE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/trace.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+
+#if defined(RETHREAD_TRACING)
+
+TEST(trace, records_wait_and_cancel)
+{
+	using namespace rethread;
+
+	trace::set_sample_rate(1);
+	trace::reset();
+
+	std::mutex m;
+	std::condition_variable cv;
+	cancellation_token_source source;
+	std::thread t([&] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); traced::cancel(source); });
+	{
+		sourced_cancellation_token token(source.create_token());
+		std::unique_lock<std::mutex> l(m);
+		traced::wait(cv, l, token);
+	}
+	t.join();
+
+	trace::metrics m1 = trace::collect();
+	const trace::event_metrics& wait = m1[trace::event::wait];
+	EXPECT_EQ(wait.count, 1u);
+	EXPECT_EQ(m1[trace::event::token_cancel].count, 1u);
+	EXPECT_GE(wait.total_ns, (std::uint64_t)std::chrono::nanoseconds(std::chrono::milliseconds(10)).count());
+	EXPECT_EQ(wait.max_ns, wait.total_ns);
+
+	std::uint64_t histogram_total = 0;
+	for (size_t i = 0; i < trace::HistogramSize; ++i)
+		histogram_total += wait.histogram[i];
+	EXPECT_EQ(histogram_total, wait.count);
+
+	trace::reset();
+	EXPECT_EQ(trace::collect()[trace::event::wait].count, 0u);
+}
+
+
+TEST(trace, sampling)
+{
+	using namespace rethread;
+
+	trace::reset();
+	standalone_cancellation_token token;
+
+	trace::set_sample_rate(4);
+	for (int i = 0; i < 100; ++i)
+		traced::sleep_for(std::chrono::nanoseconds(1), token);
+	EXPECT_EQ(trace::collect()[trace::event::sleep_for].count, 25u);
+
+	trace::set_sample_rate(0);
+	for (int i = 0; i < 100; ++i)
+		traced::sleep_for(std::chrono::nanoseconds(1), token);
+	EXPECT_EQ(trace::collect()[trace::event::sleep_for].count, 25u);
+
+	trace::set_sample_rate(1);
+	trace::reset();
+}
+
+
+TEST(trace, finished_threads)
+{
+	using namespace rethread;
+
+	trace::set_sample_rate(1);
+	trace::reset();
+	{
+		rethread::thread t([] (const cancellation_token& token) { traced::sleep_for(std::chrono::hours(1), token); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		traced::reset(t);
+	}
+
+	trace::metrics m = trace::collect();
+	EXPECT_EQ(m[trace::event::sleep_for].count, 1u);
+	EXPECT_EQ(m[trace::event::thread_reset].count, 1u);
+	EXPECT_EQ(m.dropped, 0u);
+	trace::reset();
+}
+
+#else
+
+TEST(trace, compiled_out)
+{
+	using namespace rethread;
+
+	standalone_cancellation_token token;
+	trace::set_sample_rate(1);
+	traced::sleep_for(std::chrono::nanoseconds(1), token);
+	token.cancel();
+	{
+		std::mutex m;
+		std::condition_variable cv;
+		std::unique_lock<std::mutex> l(m);
+		traced::wait(cv, l, token);
+	}
+
+	trace::metrics m = trace::collect();
+	for (size_t i = 0; i < trace::EventsCount; ++i)
+		EXPECT_EQ(m.events[i].count, 0u);
+}
+
+#endif
+
+#endif
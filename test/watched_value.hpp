@@ -0,0 +1,172 @@
+#ifndef TEST_WATCHED_VALUE_HPP
+#define TEST_WATCHED_VALUE_HPP
+
+// Copyright (c) 2016, Boris Sazonov
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted,
+// provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <rethread_ext/watched_value.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+/// @brief All the elements are equal to the version it was published with, counts live instances
+struct watched_payload
+{
+	static std::atomic<int> instances;
+
+	std::vector<std::uint64_t> data;
+
+	explicit watched_payload(std::uint64_t version) : data(16, version) { ++instances; }
+	watched_payload(const watched_payload& other) : data(other.data) { ++instances; }
+	watched_payload(watched_payload&& other) : data(std::move(other.data)) { ++instances; }
+	~watched_payload() { --instances; }
+
+	bool consistent(std::uint64_t version) const
+	{
+		for (size_t i = 0; i < data.size(); ++i)
+			if (data[i] != version)
+				return false;
+		return true;
+	}
+};
+
+std::atomic<int> watched_payload::instances{0};
+
+
+TEST(watched_value, publish_and_read)
+{
+	using namespace rethread;
+
+	watched_value<int> value(1);
+	EXPECT_EQ(*value.read(), 1);
+	EXPECT_EQ(value.version(), 1u);
+
+	watched_value<int>::snapshot old = value.read();
+	EXPECT_EQ(value.publish(2), 2u);
+	watched_value<int>::snapshot nested = value.read();
+
+	EXPECT_EQ(*old, 1);
+	EXPECT_EQ(old.version(), 1u);
+	EXPECT_EQ(*nested, 2);
+	EXPECT_EQ(nested.version(), 2u);
+}
+
+
+TEST(watched_value, too_many_reader_threads)
+{
+	using namespace rethread;
+
+	const size_t MaxReaders = detail::reader_index::MaxReaderThreads;
+	watched_value<int> value(1);
+	std::atomic<size_t> finished{0};
+	std::atomic<size_t> failed{0};
+	std::atomic<bool> release{false};
+
+	// The threads stay alive, holding their slots, until all of them have tried to read
+	std::vector<std::thread> readers;
+	for (size_t i = 0; i <= MaxReaders; ++i)
+	{
+		readers.emplace_back([&]
+		{
+			try
+			{ value.read(); }
+			catch (const std::runtime_error&)
+			{ ++failed; }
+			++finished;
+			while (!release)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		});
+		while (finished != i + 1)
+			std::this_thread::yield();
+	}
+
+	EXPECT_GE(failed, 1u);
+	release = true;
+	for (size_t i = 0; i < readers.size(); ++i)
+		readers[i].join();
+
+	std::thread([&] { EXPECT_EQ(*value.read(), 1); }).join();
+}
+
+
+TEST(watched_value, wait_for_change)
+{
+	using namespace rethread;
+
+	watched_value<int> value(0);
+	std::thread writer([&value] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); value.publish(42); });
+
+	standalone_cancellation_token token;
+	watched_value<int>::snapshot s = value.wait_for_change(1, token);
+	writer.join();
+	ASSERT_TRUE(s);
+	EXPECT_EQ(*s, 42);
+	EXPECT_EQ(s.version(), 2u);
+
+	watched_value<int>::snapshot immediate = value.wait_for_change(1, token);
+	ASSERT_TRUE(immediate);
+	EXPECT_EQ(*immediate, 42);
+}
+
+
+TEST(watched_value, wait_for_change_cancel)
+{
+	using namespace rethread;
+
+	watched_value<int> value(0);
+	standalone_cancellation_token token;
+	std::thread t([&token] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); token.cancel(); });
+	EXPECT_FALSE(value.wait_for_change(1, token));
+	t.join();
+}
+
+
+TEST(watched_value, stress)
+{
+	using namespace rethread;
+
+	{
+		watched_value<watched_payload> value(watched_payload(1));
+		std::atomic<bool> done{false};
+		std::atomic<int> inconsistent{0};
+
+		std::vector<std::thread> readers;
+		for (int i = 0; i < 4; ++i)
+			readers.emplace_back([&]
+			{
+				std::uint64_t last = 0;
+				while (!done)
+				{
+					watched_value<watched_payload>::snapshot s = value.read();
+					if (!s->consistent(s.version()) || s.version() < last)
+						++inconsistent;
+					last = s.version();
+				}
+			});
+
+		for (std::uint64_t v = 2; v < 5000; ++v)
+			value.publish(watched_payload(v));
+		done = true;
+		for (size_t i = 0; i < readers.size(); ++i)
+			readers[i].join();
+
+		EXPECT_EQ(inconsistent, 0);
+		value.publish(watched_payload(0));
+		EXPECT_EQ(watched_payload::instances, 1);
+	}
+	EXPECT_EQ(watched_payload::instances, 0);
+}
+
+#endif